@@ -0,0 +1,496 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ALLOCATOR_HPP__
+#define ALLOCATOR_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace shogun
+{
+
+// Where the storage of a Vector comes from. Resources are polymorphic, in the
+// spirit of std::pmr, so that the choice of allocator does not leak into the
+// Vector type and every pipeline stage keeps working with Vector<T>.
+// Each resource counts the requests it served, which the benchmarks report.
+struct MemoryResource
+{
+	MemoryResource() : num_allocations(0), num_bytes(0)
+	{
+	}
+
+	virtual ~MemoryResource() {}
+
+	void* allocate(size_t bytes, size_t alignment)
+	{
+		num_allocations.fetch_add(1, std::memory_order_relaxed);
+		num_bytes.fetch_add(bytes, std::memory_order_relaxed);
+		return do_allocate(bytes, alignment);
+	}
+
+	void deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		do_deallocate(p, bytes, alignment);
+	}
+
+	size_t allocations() const
+	{
+		return num_allocations.load(std::memory_order_relaxed);
+	}
+
+	size_t bytes_allocated() const
+	{
+		return num_bytes.load(std::memory_order_relaxed);
+	}
+
+protected:
+	virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment) = 0;
+
+private:
+	std::atomic<size_t> num_allocations;
+	std::atomic<size_t> num_bytes;
+};
+
+// heap memory aligned to at least a cache line, which is also the widest
+// SIMD register
+struct AlignedResource : MemoryResource
+{
+	explicit AlignedResource(size_t _alignment = 64) : alignment(_alignment)
+	{
+	}
+
+	static AlignedResource& instance()
+	{
+		static AlignedResource resource;
+		return resource;
+	}
+
+protected:
+	virtual void* do_allocate(size_t bytes, size_t _alignment) override
+	{
+		void* p = nullptr;
+		if (posix_memalign(&p, std::max({alignment, _alignment, sizeof(void*)}), bytes))
+			throw std::bad_alloc();
+		return p;
+	}
+
+	virtual void do_deallocate(void* p, size_t, size_t) override
+	{
+		std::free(p);
+	}
+
+private:
+	size_t alignment;
+};
+
+// Recycles blocks of recurring sizes, e.g. the intermediate vectors of a
+// pipeline that is evaluated over and over on same-shaped inputs. Freed
+// blocks are cached per size up to a total of max_cached bytes, everything
+// else goes to the upstream resource.
+struct PoolResource : MemoryResource
+{
+	explicit PoolResource(MemoryResource& _upstream = AlignedResource::instance(),
+		size_t _max_cached = size_t(1) << 28)
+	: upstream(_upstream), max_cached(_max_cached), cached(0), outstanding(0), orphaned(false)
+	{
+	}
+
+	virtual ~PoolResource()
+	{
+		release();
+	}
+
+	// one pool per thread, so that threads do not contend for the cache.
+	// blocks may still be freed on any thread.
+	static PoolResource& local()
+	{
+		// vectors allocated from the pool may be destroyed after its thread
+		// exited, so the pool object lives on until the last of them is gone
+		struct Owner
+		{
+			Owner() : pool(new PoolResource()) {}
+			~Owner() { pool->orphan(); }
+			PoolResource* pool;
+		};
+		thread_local Owner owner;
+		return *owner.pool;
+	}
+
+	// returns all cached blocks to upstream
+	void release()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& bin : bins)
+			for (auto p : bin.second)
+				upstream.deallocate(p, bin.first, 0);
+		bins.clear();
+		cached = 0;
+	}
+
+protected:
+	virtual void* do_allocate(size_t bytes, size_t alignment) override
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			++outstanding;
+			auto bin = bins.find(bytes);
+			if (bin != bins.end() && !bin->second.empty())
+			{
+				auto p = bin->second.back();
+				bin->second.pop_back();
+				cached -= bytes;
+				return p;
+			}
+		}
+		try
+		{
+			return upstream.allocate(bytes, alignment);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--outstanding;
+			throw;
+		}
+	}
+
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--outstanding;
+			if (!orphaned && cached + bytes <= max_cached)
+			{
+				bins[bytes].push_back(p);
+				cached += bytes;
+				return;
+			}
+			last = orphaned && outstanding == 0;
+		}
+		upstream.deallocate(p, bytes, alignment);
+		if (last)
+			delete this;
+	}
+
+private:
+	void orphan()
+	{
+		release();
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			orphaned = true;
+			last = outstanding == 0;
+		}
+		if (last)
+			delete this;
+	}
+
+	MemoryResource& upstream;
+	size_t max_cached;
+	size_t cached;
+	size_t outstanding;
+	bool orphaned;
+	std::unordered_map<size_t,std::vector<void*>> bins;
+	std::mutex mutex;
+};
+
+// Backs vectors of at least min_bytes with anonymous mappings that the kernel
+// is asked to back with transparent huge pages, which saves TLB misses when
+// streaming over very large vectors. Smaller requests go upstream.
+struct HugePageResource : MemoryResource
+{
+	static constexpr size_t huge_page_size = size_t(2) << 20;
+
+	explicit HugePageResource(size_t _min_bytes = huge_page_size,
+		MemoryResource& _upstream = AlignedResource::instance())
+	: min_bytes(_min_bytes), upstream(_upstream)
+	{
+	}
+
+protected:
+	virtual void* do_allocate(size_t bytes, size_t alignment) override
+	{
+#ifdef __linux__
+		if (bytes >= min_bytes)
+		{
+			auto p = mmap(nullptr, rounded(bytes), PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+			madvise(p, rounded(bytes), MADV_HUGEPAGE);
+#endif
+			return p;
+		}
+#endif
+		return upstream.allocate(bytes, alignment);
+	}
+
+	virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+	{
+#ifdef __linux__
+		if (bytes >= min_bytes)
+		{
+			munmap(p, rounded(bytes));
+			return;
+		}
+#endif
+		upstream.deallocate(p, bytes, alignment);
+	}
+
+private:
+	static size_t rounded(size_t bytes)
+	{
+		return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+	}
+
+	size_t min_bytes;
+	MemoryResource& upstream;
+};
+
+inline MemoryResource*& default_resource_slot()
+{
+	thread_local MemoryResource* resource = &AlignedResource::instance();
+	return resource;
+}
+
+// the resource new vectors allocate from unless told otherwise. it is set
+// per thread, e.g. to PoolResource::local() around a hot loop.
+inline MemoryResource* default_resource()
+{
+	return default_resource_slot();
+}
+
+// returns the previous default
+inline MemoryResource* set_default_resource(MemoryResource* resource)
+{
+	auto previous = default_resource_slot();
+	default_resource_slot() = resource;
+	return previous;
+}
+
+// frees an array allocated by allocate_array() back into its resource
+template <class T>
+struct ResourceDeleter
+{
+	ResourceDeleter() : resource(nullptr), size(0)
+	{
+	}
+
+	ResourceDeleter(MemoryResource* _resource, size_t _size) : resource(_resource), size(_size)
+	{
+	}
+
+	void operator()(T* p) const
+	{
+		destroy(p, std::is_trivially_destructible<T>());
+		resource->deallocate(p, size * sizeof(T), alignof(T));
+	}
+
+	void destroy(T*, std::true_type) const
+	{
+	}
+
+	void destroy(T* p, std::false_type) const
+	{
+		for (size_t i = 0; i < size; ++i)
+			p[i].~T();
+	}
+
+	MemoryResource* resource;
+	size_t size;
+};
+
+template <class T>
+using resource_ptr = std::unique_ptr<T[],ResourceDeleter<T>>;
+
+// size elements from resource, value-initialized if zero is true and
+// default-initialized otherwise
+template <class T>
+resource_ptr<T> allocate_array(size_t size, MemoryResource* resource, bool zero)
+{
+	if (size == 0)
+		return resource_ptr<T>(nullptr, ResourceDeleter<T>(resource, 0));
+	auto p = static_cast<T*>(resource->allocate(size * sizeof(T), alignof(T)));
+	if (std::is_trivially_default_constructible<T>::value)
+	{
+		if (zero)
+			std::memset(static_cast<void*>(p), 0, size * sizeof(T));
+		return resource_ptr<T>(p, ResourceDeleter<T>(resource, size));
+	}
+	size_t constructed = 0;
+	try
+	{
+		for (; constructed < size; ++constructed)
+			zero ? new (p + constructed) T() : new (p + constructed) T;
+	}
+	catch (...)
+	{
+		ResourceDeleter<T>(resource, constructed).destroy(p, std::false_type());
+		resource->deallocate(p, size * sizeof(T), alignof(T));
+		throw;
+	}
+	return resource_ptr<T>(p, ResourceDeleter<T>(resource, size));
+}
+
+// Reference counted elements of a Vector. Copies and slices are O(1) and
+// share the elements. The const accessors never copy, the mutable ones first
+// give this array a private copy of its elements if they are shared with
+// anyone else (copy-on-write), in the resource they came from. Pointers
+// obtained from the mutable accessors are only private until the next copy.
+template <class T>
+struct SharedArray
+{
+	SharedArray() : data(nullptr), size(0), read_only(false)
+	{
+	}
+
+	SharedArray(resource_ptr<T>&& array, size_t _size) : data(array.get()), size(_size), read_only(false)
+	{
+		if (data)
+			owner = std::shared_ptr<T>(array.release(), array.get_deleter());
+	}
+
+	// elements owned by anything else, e.g. a mapped file. read only ones
+	// are copied on the first write even when they are not shared.
+	SharedArray(std::shared_ptr<T> _owner, size_t _size, bool _read_only)
+	: owner(std::move(_owner)), data(owner.get()), size(_size), read_only(_read_only)
+	{
+	}
+
+	SharedArray(const SharedArray&) = default;
+
+	SharedArray(SharedArray&& other)
+	: owner(std::move(other.owner)), data(other.data), size(other.size), read_only(other.read_only)
+	{
+		other.data = nullptr;
+		other.size = 0;
+	}
+
+	SharedArray& operator=(const SharedArray&) = default;
+
+	SharedArray& operator=(SharedArray&& other)
+	{
+		owner = std::move(other.owner);
+		data = other.data;
+		size = other.size;
+		read_only = other.read_only;
+		other.data = nullptr;
+		other.size = 0;
+		return *this;
+	}
+
+	const T* get() const
+	{
+		return data;
+	}
+
+	// mutable access copies shared or read only elements first, and checks
+	// for that on every call, so loops should only call it once
+	T* get()
+	{
+		detach();
+		return data;
+	}
+
+	const T& operator[](size_t i) const
+	{
+		return data[i];
+	}
+
+	T& operator[](size_t i)
+	{
+		detach();
+		return data[i];
+	}
+
+	// whether the elements can be written in place, without anyone else
+	// seeing it
+	bool unique() const
+	{
+		return !owner || (!read_only && owner.use_count() == 1);
+	}
+
+	// elements [begin, end), sharing them with this array
+	SharedArray slice(size_t begin, size_t end) const
+	{
+		SharedArray part(*this);
+		part.data = data + begin;
+		part.size = end - begin;
+		return part;
+	}
+
+	MemoryResource* resource() const
+	{
+		auto deleter = owner ? std::get_deleter<ResourceDeleter<T>>(owner) : nullptr;
+		return deleter ? deleter->resource : default_resource();
+	}
+
+	void detach()
+	{
+		if (unique())
+		{
+			// the other owners may have written just before they let go
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return;
+		}
+		auto copy = allocate_array<T>(size, resource(), false);
+		std::copy(data, data + size, copy.get());
+		*this = SharedArray(std::move(copy), size);
+	}
+
+private:
+	std::shared_ptr<T> owner;
+	T* data;
+	size_t size;
+	bool read_only;
+};
+
+}
+#endif // ALLOCATOR_HPP__
@@ -0,0 +1,390 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BLOCKREADER_HPP__
+#define BLOCKREADER_HPP__
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <shogun/lib/Stream.hpp>
+#include <shogun/lib/View.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shogun
+{
+
+// how often either side of a BlockReader had to wait for the other. a
+// consumer which stalls a lot is I/O bound, or needs a deeper read-ahead
+// to ride out bursts of slow reads.
+struct BlockReaderStats
+{
+	size_t blocks;
+	// pulls which found no block read yet
+	size_t stalls;
+	// reads which found every buffer still ahead of the consumer
+	size_t idle;
+};
+
+// Reads a file descriptor block by block on a thread of its own, up to depth
+// blocks ahead of the consumer. The blocks are read into a ring of depth + 1
+// buffers which are reused, so the reader allocates nothing once it runs.
+//
+// A pipe or socket may block a read indefinitely, e.g. once take(n) stopped
+// pulling from a producer which has not written more. Such descriptors are
+// polled together with an eventfd which the destructor signals, so it never
+// waits for more input. Regular files do not block and are read directly.
+template <class T>
+struct BlockReader
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+		"blocks hold the raw bytes of their elements");
+
+	struct Block
+	{
+		size_t buffer;
+		size_t size;
+	};
+
+	// closes fd when done if owns_fd is true
+	BlockReader(int _fd, bool _owns_fd, size_t _block_size, size_t depth)
+	: fd(_fd), owns_fd(_owns_fd), wake(-1), block_size(_block_size), current(none),
+	  done(false), cancelled(false), counters{0, 0, 0}
+	{
+		if (block_size == 0 || depth == 0)
+		{
+			close_fd();
+			throw std::invalid_argument("block size and read-ahead depth have to be positive");
+		}
+		try
+		{
+			open_wake();
+			for (size_t i = 0; i <= depth; ++i)
+			{
+				buffers.emplace_back(block_size, Uninitialized());
+				free.push_back(i);
+			}
+		}
+		catch (...)
+		{
+			close_fd();
+			throw;
+		}
+	}
+
+	BlockReader(const BlockReader&) = delete;
+	BlockReader& operator=(const BlockReader&) = delete;
+
+	~BlockReader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cancelled = true;
+		}
+		changed.notify_all();
+		signal_wake();
+		if (reader.joinable())
+			reader.join();
+		close_fd();
+	}
+
+	// the next block, valid until the following call, or an empty view at
+	// the end. an error of the reader is rethrown here, after the blocks
+	// before it.
+	VectorView<const T> next()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!reader.joinable())
+			reader = std::thread([this]() { run(); });
+		if (current != none)
+		{
+			free.push_back(current);
+			current = none;
+			changed.notify_all();
+		}
+		if (ready.empty() && !done)
+		{
+			++counters.stalls;
+			changed.wait(lock, [this]() { return !ready.empty() || done; });
+		}
+		if (ready.empty())
+		{
+			if (error)
+				std::rethrow_exception(std::exchange(error, nullptr));
+			return VectorView<const T>(nullptr, 0);
+		}
+		auto block = ready.front();
+		ready.pop_front();
+		current = block.buffer;
+		++counters.blocks;
+		return VectorView<const T>(buffers[block.buffer].vec.get(), block.size);
+	}
+
+	BlockReaderStats stats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return counters;
+	}
+
+private:
+	static constexpr size_t none = static_cast<size_t>(-1);
+
+	void run()
+	{
+		try
+		{
+			while (true)
+			{
+				size_t buffer;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					if (free.empty() && !cancelled)
+					{
+						++counters.idle;
+						changed.wait(lock, [this]() { return !free.empty() || cancelled; });
+					}
+					if (cancelled)
+						break;
+					buffer = free.front();
+					free.pop_front();
+				}
+				// the buffer belongs to this thread until it is handed over
+				auto size = read_block(buffers[buffer].vec.get());
+				if (size == none)
+					break;
+				std::lock_guard<std::mutex> lock(mutex);
+				if (size)
+					ready.push_back(Block{buffer, size});
+				if (size < block_size)
+					break;
+				changed.notify_all();
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			error = std::current_exception();
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		changed.notify_all();
+	}
+
+	// fills dst up to a whole block, less only at the end of the input, or
+	// returns none once the destructor cancelled a read which would block
+	size_t read_block(T* dst)
+	{
+#ifdef __linux__
+		auto bytes = reinterpret_cast<char*>(dst);
+		const size_t wanted = block_size * sizeof(T);
+		size_t got = 0;
+		while (got < wanted)
+		{
+			if (wake >= 0 && !wait_readable())
+				return none;
+			auto n = ::read(fd, bytes + got, wanted - got);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				throw std::runtime_error(std::string("cannot read block: ") + std::strerror(errno));
+			if (n == 0)
+				break;
+			got += static_cast<size_t>(n);
+		}
+		if (got % sizeof(T) != 0)
+			throw std::invalid_argument("the input is not a whole number of elements");
+		return got / sizeof(T);
+#else
+		(void)dst;
+		throw std::runtime_error("block reading is not supported on this platform");
+#endif
+	}
+
+#ifdef __linux__
+	// false once wake was signalled
+	bool wait_readable()
+	{
+		pollfd fds[2] = {{fd, POLLIN, 0}, {wake, POLLIN, 0}};
+		while (::poll(fds, 2, -1) < 0)
+		{
+			if (errno != EINTR)
+				throw std::runtime_error(std::string("cannot poll for a block: ") + std::strerror(errno));
+		}
+		return !(fds[1].revents & POLLIN);
+	}
+#endif
+
+	// only for descriptors whose reads may block, see above
+	void open_wake()
+	{
+#ifdef __linux__
+		struct stat info;
+		if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+			return;
+		wake = ::eventfd(0, EFD_CLOEXEC);
+		if (wake < 0)
+			throw std::runtime_error(std::string("cannot create an eventfd: ") + std::strerror(errno));
+#endif
+	}
+
+	void signal_wake()
+	{
+#ifdef __linux__
+		if (wake >= 0)
+		{
+			uint64_t one = 1;
+			while (::write(wake, &one, sizeof(one)) < 0 && errno == EINTR);
+		}
+#endif
+	}
+
+	void close_fd()
+	{
+#ifdef __linux__
+		if (owns_fd && fd >= 0)
+			::close(fd);
+		if (wake >= 0)
+			::close(wake);
+#endif
+		fd = -1;
+		wake = -1;
+	}
+
+	int fd;
+	bool owns_fd;
+	// signalled by the destructor, or -1 for regular files
+	int wake;
+	const size_t block_size;
+	std::vector<Vector<T>> buffers;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<size_t> free;
+	std::deque<Block> ready;
+	// the buffer the consumer holds
+	size_t current;
+	bool done;
+	bool cancelled;
+	std::exception_ptr error;
+	BlockReaderStats counters;
+	std::thread reader;
+};
+
+// a stream of the blocks of a BlockReader, as views which are only valid
+// until the next pull. pipelines which keep blocks around have to copy them,
+// and async() is rejected unless a map() copied them. copies share the
+// reader.
+template <class T>
+struct BlockSource
+{
+	using value_type = VectorView<const T>;
+
+	explicit BlockSource(std::shared_ptr<BlockReader<T>> _reader) : reader(std::move(_reader))
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		auto block = reader->next();
+		if (!block.size)
+			return false;
+		sink(static_cast<const value_type&>(block));
+		return true;
+	}
+
+	BlockReaderStats stats() const
+	{
+		return reader->stats();
+	}
+
+	std::shared_ptr<BlockReader<T>> reader;
+};
+
+template <class T>
+struct is_transient<BlockSource<T>> : std::true_type
+{
+};
+
+namespace Functional
+{
+
+// blocks of block_size Ts read from fd, which stays open, with up to depth
+// blocks read ahead on a background thread. the last block may be shorter.
+template <class T>
+Stream<BlockSource<T>> read_blocks(int fd, size_t block_size, size_t depth = 2)
+{
+	return Stream<BlockSource<T>>(BlockSource<T>(
+		std::make_shared<BlockReader<T>>(fd, false, block_size, depth)));
+}
+
+// the same for a raw binary file of Ts, see save_raw()
+template <class T>
+Stream<BlockSource<T>> read_blocks(const std::string& path, size_t block_size, size_t depth = 2)
+{
+#ifdef __linux__
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	return Stream<BlockSource<T>>(BlockSource<T>(
+		std::make_shared<BlockReader<T>>(fd, true, block_size, depth)));
+#else
+	(void)block_size;
+	(void)depth;
+	throw std::runtime_error("cannot open " + path + ": not supported on this platform");
+#endif
+}
+
+}
+
+}
+#endif // BLOCKREADER_HPP__
@@ -0,0 +1,131 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CACHE_HPP__
+#define CACHE_HPP__
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <shogun/lib/Allocator.hpp>
+#include <shogun/lib/Eval.hpp>
+#include <shogun/lib/Mapper.hpp>
+
+namespace shogun
+{
+
+// A pipeline result which is computed at most once, the first time it is
+// used, and read from its buffer afterwards, e.g. per sample norms which
+// several distance computations need. Copies share the buffer, and any
+// number of threads may use them at the same time: one of them runs the
+// upstream, the others wait for it. If the upstream throws, the next use
+// tries again.
+template <template <class> class Functor, class T>
+struct Cached
+{
+	// producer computes the Functor<T>, it is released once it has run
+	template <class Producer>
+	explicit Cached(const Producer& producer, MemoryResource* resource = nullptr)
+	: state(std::make_shared<State>(producer, resource))
+	{
+	}
+
+	// materializes on first use
+	const Functor<T>& get() const
+	{
+		// std::call_once cannot be retried after an exception with libstdc++,
+		// hence the double checked lock
+		if (!state->ready.load(std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (!state->ready.load(std::memory_order_relaxed))
+			{
+				// allocations of the upstream go to the persisting resource
+				struct Restore
+				{
+					~Restore()
+					{
+						if (previous)
+							set_default_resource(previous);
+					}
+					MemoryResource* previous;
+				} restore{state->resource ? set_default_resource(state->resource) : nullptr};
+				state->value = state->producer();
+				state->producer = nullptr;
+				state->ready.store(true, std::memory_order_release);
+			}
+		}
+		return state->value;
+	}
+
+	bool ready() const
+	{
+		return state->ready;
+	}
+
+	// a pipeline over the buffer, which keeps the buffer alive
+	Eval<Functor,T,T,Identity<T>> evaluate() const
+	{
+		get();
+		return Eval<Functor,T,T,Identity<T>>(Identity<T>(),
+			std::shared_ptr<const Functor<T>>(state, &state->value));
+	}
+
+	template <class Mapper>
+	auto map(const Mapper& mapper) const
+	{
+		return evaluate().map(mapper);
+	}
+
+private:
+	struct State
+	{
+		template <class Producer>
+		State(const Producer& _producer, MemoryResource* _resource)
+		: producer(_producer), resource(_resource), ready(false)
+		{
+		}
+
+		std::mutex mutex;
+		std::function<Functor<T>()> producer;
+		MemoryResource* resource;
+		Functor<T> value;
+		std::atomic<bool> ready;
+	};
+
+	std::shared_ptr<State> state;
+};
+
+}
+#endif // CACHE_HPP__
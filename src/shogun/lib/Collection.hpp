@@ -45,6 +45,12 @@
 namespace shogun
 {
 
+// requests storage whose elements are about to be overwritten anyway, so
+// arithmetic elements are left uninitialized instead of being zeroed
+struct Uninitialized
+{
+};
+
 template <class T>
 struct Collection : public Monad<T>
 {
@@ -0,0 +1,546 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COLLECTORS_HPP__
+#define COLLECTORS_HPP__
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <shogun/lib/Collection.hpp>
+#include <shogun/lib/Mapper.hpp>
+#include <shogun/lib/View.hpp>
+
+namespace shogun
+{
+
+template <class T> struct Vector;
+template <class... Ts> struct RecordVector;
+
+// the RecordVector holding the fields of tuple like records
+template <class T>
+struct records_of;
+
+template <class... Ts>
+struct records_of<std::tuple<Ts...>>
+{
+	using type = RecordVector<Ts...>;
+};
+
+template <class T, class U>
+struct records_of<std::pair<T,U>>
+{
+	using type = RecordVector<T,U>;
+};
+
+template <class T>
+using records_of_t = typename records_of<T>::type;
+
+// A collector folds the elements of a pipeline into a mutable container.
+// Every collector provides
+//
+//     template <class T> Container supply() const;   empty container for Ts
+//     void accumulate(Container&, const T&) const;   adds one element
+//     Result finish(Container&&) const;              the final result
+//
+// and, if its combinable type is std::true_type,
+//
+//     void combine(Container&, Container&&) const;   merges a partial result
+//
+// so that a parallel collect can fill one container per chunk and merge
+// them in chunk order afterwards.
+namespace Collectors
+{
+
+struct NoCombiner
+{
+};
+
+struct NoFinisher
+{
+};
+
+// member functions are called on their first argument, the container, so
+// that e.g. &Statistic::add can be passed as an accumulator
+template <class F>
+const F& callable(const F& f)
+{
+	return f;
+}
+
+template <class M, class C>
+auto callable(M C::* member)
+{
+	return std::mem_fn(member);
+}
+
+template <class F>
+using callable_t = typename std::decay<decltype(callable(std::declval<const F&>()))>::type;
+
+// wraps user supplied functions, e.g. collect([&c]() { return c; }, &Statistic::add)
+template <class Supplier, class Accumulator, class Combiner, class Finisher>
+struct Collector
+{
+	using combinable = std::integral_constant<bool, !std::is_same<Combiner,NoCombiner>::value>;
+
+	Collector(const Supplier& _supplier, const Accumulator& _accumulator,
+		const Combiner& _combiner, const Finisher& _finisher)
+	: supplier(_supplier), accumulator(_accumulator), combiner(_combiner), finisher(_finisher)
+	{
+	}
+
+	template <class T>
+	typename std::decay<decltype((std::declval<const Supplier&>())())>::type supply() const
+	{
+		return supplier();
+	}
+
+	template <class Container, class T>
+	void accumulate(Container& container, const T& value) const
+	{
+		accumulator(container, value);
+	}
+
+	template <class Container>
+	void combine(Container& container, Container&& other) const
+	{
+		combiner(container, other);
+	}
+
+	template <class Container>
+	Container finish(Container&& container, NoFinisher) const
+	{
+		return std::move(container);
+	}
+
+	template <class Container, class F>
+	auto finish(Container&& container, const F& f) const
+	{
+		return f(std::move(container));
+	}
+
+	template <class Container>
+	auto finish(Container&& container) const
+	{
+		return finish(std::move(container), finisher);
+	}
+
+	Supplier supplier;
+	Accumulator accumulator;
+	Combiner combiner;
+	Finisher finisher;
+};
+
+template <class Supplier, class Accumulator>
+Collector<callable_t<Supplier>,callable_t<Accumulator>,NoCombiner,NoFinisher>
+of(const Supplier& supplier, const Accumulator& accumulator)
+{
+	return Collector<callable_t<Supplier>,callable_t<Accumulator>,NoCombiner,NoFinisher>(
+		callable(supplier), callable(accumulator), NoCombiner(), NoFinisher());
+}
+
+template <class Supplier, class Accumulator, class Combiner>
+Collector<callable_t<Supplier>,callable_t<Accumulator>,callable_t<Combiner>,NoFinisher>
+of(const Supplier& supplier, const Accumulator& accumulator, const Combiner& combiner)
+{
+	return Collector<callable_t<Supplier>,callable_t<Accumulator>,callable_t<Combiner>,NoFinisher>(
+		callable(supplier), callable(accumulator), callable(combiner), NoFinisher());
+}
+
+template <class Supplier, class Accumulator, class Combiner, class Finisher>
+Collector<callable_t<Supplier>,callable_t<Accumulator>,callable_t<Combiner>,callable_t<Finisher>>
+of(const Supplier& supplier, const Accumulator& accumulator, const Combiner& combiner,
+	const Finisher& finisher)
+{
+	return Collector<callable_t<Supplier>,callable_t<Accumulator>,callable_t<Combiner>,
+		callable_t<Finisher>>(callable(supplier), callable(accumulator), callable(combiner),
+		callable(finisher));
+}
+
+// element type of a collector which may be left unspecified (void) and is
+// then taken from the pipeline
+template <class T, class U>
+using element_t = typename std::conditional<std::is_void<T>::value, U, T>::type;
+
+template <class T>
+struct ToStlVector
+{
+	using combinable = std::true_type;
+
+	template <class U>
+	std::vector<element_t<T,U>> supply() const
+	{
+		return std::vector<element_t<T,U>>();
+	}
+
+	template <class E, class U>
+	void accumulate(std::vector<E>& container, const U& value) const
+	{
+		container.push_back(value);
+	}
+
+	template <class E>
+	void combine(std::vector<E>& container, std::vector<E>&& other) const
+	{
+		container.insert(container.end(),
+			std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+	}
+
+	template <class E>
+	std::vector<E> finish(std::vector<E>&& container) const
+	{
+		return std::move(container);
+	}
+};
+
+template <class T>
+struct ToVector : ToStlVector<T>
+{
+	template <class E>
+	Vector<E> finish(std::vector<E>&& container) const
+	{
+		Vector<E> target(container.size(), Uninitialized());
+		std::move(container.begin(), container.end(), target.vec.get());
+		return target;
+	}
+};
+
+// writes straight into caller owned storage, with no intermediate container.
+// pipelines with a known size write element i to position i, in parallel if
+// asked to, others append in order. overflowing the storage throws.
+template <class T>
+struct Destination
+{
+	using combinable = std::false_type;
+
+	struct Cursor
+	{
+		T* next;
+		T* end;
+	};
+
+	Destination(T* _data, size_t _size) : data(_data), size(_size)
+	{
+	}
+
+	template <class U>
+	Cursor supply() const
+	{
+		return Cursor{data, data + size};
+	}
+
+	template <class U>
+	void accumulate(Cursor& cursor, const U& value) const
+	{
+		if (cursor.next == cursor.end)
+			throw std::out_of_range("destination is full");
+		*cursor.next++ = value;
+	}
+
+	// number of elements written
+	size_t finish(Cursor&& cursor) const
+	{
+		return cursor.next - data;
+	}
+
+	T* data;
+	size_t size;
+};
+
+// a Destination which may be strided, e.g. a row of a matrix. it is always
+// filled in order, through the generic path.
+template <class T>
+struct ViewDestination
+{
+	using combinable = std::false_type;
+
+	struct Cursor
+	{
+		typename VectorView<T>::iterator next;
+		typename VectorView<T>::iterator end;
+	};
+
+	explicit ViewDestination(const VectorView<T>& _view) : view(_view)
+	{
+	}
+
+	template <class U>
+	Cursor supply() const
+	{
+		return Cursor{view.begin(), view.end()};
+	}
+
+	template <class U>
+	void accumulate(Cursor& cursor, const U& value) const
+	{
+		if (cursor.next == cursor.end)
+			throw std::out_of_range("destination is full");
+		*cursor.next++ = value;
+	}
+
+	// number of elements written
+	size_t finish(Cursor&& cursor) const
+	{
+		return cursor.next - view.begin();
+	}
+
+	VectorView<T> view;
+};
+
+// tuple like records of unknown number, appended field by field to one
+// column each and moved into a RecordVector at the end
+struct ToRecords
+{
+	using combinable = std::true_type;
+
+	template <class T>
+	struct Columns;
+
+	template <class... Ts>
+	struct Columns<RecordVector<Ts...>>
+	{
+		using type = std::tuple<std::vector<Ts>...>;
+	};
+
+	template <class T>
+	typename Columns<records_of_t<T>>::type supply() const
+	{
+		return typename Columns<records_of_t<T>>::type();
+	}
+
+	template <class... Es, class T>
+	void accumulate(std::tuple<std::vector<Es>...>& columns, const T& record) const
+	{
+		accumulate(columns, record, std::index_sequence_for<Es...>());
+	}
+
+	template <class... Es>
+	void combine(std::tuple<std::vector<Es>...>& columns, std::tuple<std::vector<Es>...>&& other) const
+	{
+		combine(columns, other, std::index_sequence_for<Es...>());
+	}
+
+	template <class... Es>
+	RecordVector<Es...> finish(std::tuple<std::vector<Es>...>&& columns) const
+	{
+		RecordVector<Es...> target(std::get<0>(columns).size(), Uninitialized());
+		finish(columns, target, std::index_sequence_for<Es...>());
+		return target;
+	}
+
+private:
+	template <class Columns, class T, size_t... I>
+	void accumulate(Columns& columns, const T& record, std::index_sequence<I...>) const
+	{
+		using std::get;
+		(void)std::initializer_list<int>{(get<I>(columns).push_back(get<I>(record)), 0)...};
+	}
+
+	template <class Columns, size_t... I>
+	void combine(Columns& columns, Columns& other, std::index_sequence<I...>) const
+	{
+		(void)std::initializer_list<int>{(std::get<I>(columns).insert(std::get<I>(columns).end(),
+			std::make_move_iterator(std::get<I>(other).begin()),
+			std::make_move_iterator(std::get<I>(other).end())), 0)...};
+	}
+
+	template <class Columns, class Records, size_t... I>
+	void finish(Columns& columns, Records& target, std::index_sequence<I...>) const
+	{
+		(void)std::initializer_list<int>{(std::move(std::get<I>(columns).begin(),
+			std::get<I>(columns).end(), target.template column<I>().vec.get()), 0)...};
+	}
+};
+
+// scatters the fields of each record straight into the columns of caller
+// owned records, see Destination
+template <class Records>
+struct RecordDestination
+{
+	using combinable = std::false_type;
+
+	// the columns are detached once, not per record
+	struct Cursor
+	{
+		size_t next;
+		decltype(std::declval<Records&>().data()) columns;
+	};
+
+	explicit RecordDestination(Records& _target) : target(_target)
+	{
+	}
+
+	template <class U>
+	Cursor supply() const
+	{
+		return Cursor{0, target.data()};
+	}
+
+	template <class U>
+	void accumulate(Cursor& cursor, const U& record) const
+	{
+		if (cursor.next == target.size())
+			throw std::out_of_range("destination is full");
+		Records::set(cursor.columns, cursor.next++, record);
+	}
+
+	// number of records written
+	size_t finish(Cursor&& cursor) const
+	{
+		return cursor.next;
+	}
+
+	Records& target;
+};
+
+template <class Key, class Downstream>
+struct GroupingBy
+{
+	using combinable = typename Downstream::combinable;
+
+	template <class T>
+	using container_type = std::unordered_map<map_result_t<Key,T>,
+		decltype(std::declval<const Downstream&>().template supply<T>())>;
+
+	GroupingBy(const Key& _key, const Downstream& _downstream) : key(_key), downstream(_downstream)
+	{
+	}
+
+	template <class T>
+	container_type<T> supply() const
+	{
+		return container_type<T>();
+	}
+
+	template <class Map, class T>
+	void accumulate(Map& groups, const T& value) const
+	{
+		auto k = key(value);
+		auto group = groups.find(k);
+		if (group == groups.end())
+			group = groups.emplace(std::move(k), downstream.template supply<T>()).first;
+		downstream.accumulate(group->second, value);
+	}
+
+	template <class Map>
+	void combine(Map& groups, Map&& other) const
+	{
+		for (auto& entry : other)
+		{
+			auto group = groups.find(entry.first);
+			if (group == groups.end())
+				groups.emplace(entry.first, std::move(entry.second));
+			else
+				downstream.combine(group->second, std::move(entry.second));
+		}
+	}
+
+	template <class Map>
+	auto finish(Map&& groups) const
+	{
+		using Result = decltype(downstream.finish(std::move(groups.begin()->second)));
+		std::unordered_map<typename Map::key_type,Result> result;
+		for (auto& entry : groups)
+			result.emplace(entry.first, downstream.finish(std::move(entry.second)));
+		return result;
+	}
+
+	Key key;
+	Downstream downstream;
+};
+
+template <class T = void>
+ToStlVector<T> to_stl_vector()
+{
+	return ToStlVector<T>();
+}
+
+template <class T = void>
+ToVector<T> to_vector()
+{
+	return ToVector<T>();
+}
+
+template <class T>
+Destination<T> to_vector(Vector<T>& destination)
+{
+	return Destination<T>(destination.vec.get(), destination.vlen);
+}
+
+template <class T>
+Destination<T> to_vector(T* data, size_t size)
+{
+	return Destination<T>(data, size);
+}
+
+template <class T>
+ViewDestination<T> to_vector(const VectorView<T>& destination)
+{
+	return ViewDestination<T>(destination);
+}
+
+inline ToRecords to_records()
+{
+	return ToRecords();
+}
+
+template <class... Ts>
+RecordDestination<RecordVector<Ts...>> to_records(RecordVector<Ts...>& target)
+{
+	return RecordDestination<RecordVector<Ts...>>(target);
+}
+
+// groups the elements by key into std::vectors, or into whatever the
+// downstream collector produces for each group
+template <class Key, class Downstream>
+GroupingBy<Key,Downstream> grouping_by(const Key& key, const Downstream& downstream)
+{
+	return GroupingBy<Key,Downstream>(key, downstream);
+}
+
+template <class Key>
+GroupingBy<Key,ToStlVector<void>> grouping_by(const Key& key)
+{
+	return grouping_by(key, to_stl_vector());
+}
+
+}
+
+}
+#endif // COLLECTORS_HPP__
@@ -0,0 +1,691 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef COLUMNAR_HPP__
+#define COLUMNAR_HPP__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <shogun/lib/Collectors.hpp>
+#include <shogun/lib/Mapped.hpp>
+#include <shogun/lib/Math.hpp>
+#include <shogun/lib/Stream.hpp>
+#include <shogun/lib/ThreadPool.hpp>
+#include <shogun/lib/Vector.hpp>
+
+// A column file stores a Vector<T> of numbers in chunks, each encoded on its
+// own, followed by an index with an entry per chunk and a fixed size footer:
+//
+//     chunk 0 | chunk 1 | ... | ColumnChunk[num_chunks] | ColumnFooter
+//
+// so that any chunk can be found, skipped by its min and max, or decoded
+// without touching the others. integer chunks take the smallest of
+//
+//     plain               the raw elements
+//     frame_of_reference  element - min, bit packed
+//     delta               first element, then differences - min difference,
+//                         bit packed, e.g. for sorted ids or timestamps
+//     dictionary          the distinct elements, then bit packed indices
+//
+// and floating point chunks are plain. everything is in the byte order of
+// the machine, like save_raw().
+
+namespace shogun
+{
+
+enum class ColumnEncoding : uint8_t
+{
+	plain,
+	frame_of_reference,
+	delta,
+	dictionary
+};
+
+// the index entry of a chunk
+struct ColumnChunk
+{
+	uint64_t offset;
+	uint64_t bytes;
+	uint64_t count;
+	// frame of reference: the minimum. delta: the smallest difference
+	int64_t reference;
+	// delta: the first element
+	int64_t start;
+	// dictionary: the number of distinct elements
+	uint64_t entries;
+	// raw bytes of the smallest and largest element
+	uint8_t min[8];
+	uint8_t max[8];
+	ColumnEncoding encoding;
+	uint8_t bits;
+	uint8_t padding[6];
+};
+
+struct ColumnFooter
+{
+	char magic[8];
+	uint32_t version;
+	// kind of number and its size, see column_type()
+	uint32_t type;
+	uint64_t num_chunks;
+	uint64_t size;
+};
+
+namespace columnar
+{
+
+constexpr char magic[8] = {'F', 'S', 'C', 'O', 'L', 'U', 'M', 'N'};
+constexpr uint32_t version = 1;
+
+template <class T>
+uint32_t column_type()
+{
+	const uint32_t kind = std::is_floating_point<T>::value ? 2 : std::is_signed<T>::value ? 1 : 0;
+	return kind << 8 | sizeof(T);
+}
+
+// two's complement bits, which make the differences wrap around
+template <class T>
+uint64_t raw(T x)
+{
+	return static_cast<uint64_t>(x);
+}
+
+inline unsigned bit_width(uint64_t x)
+{
+	return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+template <class T>
+ColumnChunk describe(const T* values, size_t n)
+{
+	ColumnChunk chunk{};
+	chunk.count = n;
+	const auto range = std::minmax_element(values, values + n);
+	std::memcpy(chunk.min, range.first, sizeof(T));
+	std::memcpy(chunk.max, range.second, sizeof(T));
+	return chunk;
+}
+
+template <class T>
+T bound(const uint8_t (&bytes)[8])
+{
+	T x;
+	std::memcpy(&x, bytes, sizeof(T));
+	return x;
+}
+
+template <class T>
+ColumnChunk encode(const T* values, size_t n, std::vector<uint8_t>& payload, std::vector<uint64_t>&, std::false_type)
+{
+	auto chunk = describe(values, n);
+	chunk.encoding = ColumnEncoding::plain;
+	chunk.bytes = n * sizeof(T);
+	payload.resize(chunk.bytes);
+	std::memcpy(payload.data(), values, chunk.bytes);
+	return chunk;
+}
+
+// sizes every encoding and writes the smallest into payload, which has 8
+// bytes of slack for pack()
+template <class T>
+ColumnChunk encode(const T* values, size_t n, std::vector<uint8_t>& payload, std::vector<uint64_t>& scratch, std::true_type)
+{
+	auto chunk = describe(values, n);
+	const auto lo = raw(bound<T>(chunk.min));
+	const auto hi = raw(bound<T>(chunk.max));
+
+	auto encoding = ColumnEncoding::plain;
+	size_t best = n * sizeof(T);
+	const auto reference_bits = bit_width(hi - lo);
+	if (reference_bits <= math::max_packed_bits && math::packed_bytes(n, reference_bits) < best)
+	{
+		encoding = ColumnEncoding::frame_of_reference;
+		best = math::packed_bytes(n, reference_bits);
+	}
+
+	auto smallest = std::numeric_limits<int64_t>::max();
+	auto largest = std::numeric_limits<int64_t>::min();
+	for (size_t i = 1; i < n; ++i)
+	{
+		const auto difference = static_cast<int64_t>(raw(values[i]) - raw(values[i - 1]));
+		smallest = std::min(smallest, difference);
+		largest = std::max(largest, difference);
+	}
+	const auto delta_bits = n > 1 ? bit_width(raw(largest) - raw(smallest)) : 0;
+	if (delta_bits <= math::max_packed_bits && math::packed_bytes(n - 1, delta_bits) < best)
+	{
+		encoding = ColumnEncoding::delta;
+		best = math::packed_bytes(n - 1, delta_bits);
+	}
+
+	std::vector<T> dictionary(values, values + n);
+	std::sort(dictionary.begin(), dictionary.end());
+	dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+	const auto index_bits = bit_width(dictionary.size() - 1);
+	if (index_bits <= 16 && dictionary.size() * sizeof(T) + math::packed_bytes(n, index_bits) < best)
+		encoding = ColumnEncoding::dictionary;
+
+	chunk.encoding = encoding;
+	scratch.resize(n);
+	size_t header = 0;
+	size_t packed = n;
+	switch (encoding)
+	{
+	case ColumnEncoding::frame_of_reference:
+		chunk.reference = static_cast<int64_t>(lo);
+		chunk.bits = reference_bits;
+		for (size_t i = 0; i < n; ++i)
+			scratch[i] = raw(values[i]) - lo;
+		break;
+	case ColumnEncoding::delta:
+		chunk.reference = smallest;
+		chunk.start = static_cast<int64_t>(raw(values[0]));
+		chunk.bits = delta_bits;
+		for (size_t i = 1; i < n; ++i)
+			scratch[i - 1] = raw(values[i]) - raw(values[i - 1]) - raw(smallest);
+		packed = n - 1;
+		break;
+	case ColumnEncoding::dictionary:
+		chunk.entries = dictionary.size();
+		chunk.bits = index_bits;
+		for (size_t i = 0; i < n; ++i)
+			scratch[i] = std::lower_bound(dictionary.begin(), dictionary.end(), values[i]) - dictionary.begin();
+		header = dictionary.size() * sizeof(T);
+		break;
+	default:
+		return encode(values, n, payload, scratch, std::false_type());
+	}
+	chunk.bytes = header + math::packed_bytes(packed, chunk.bits);
+	payload.assign(chunk.bytes + sizeof(uint64_t), 0);
+	std::memcpy(payload.data(), dictionary.data(), header);
+	math::pack(scratch.data(), packed, chunk.bits, payload.data() + header);
+	return chunk;
+}
+
+inline size_t expected_bytes(const ColumnChunk& chunk, size_t element_size)
+{
+	switch (chunk.encoding)
+	{
+	case ColumnEncoding::plain:
+		return chunk.count * element_size;
+	case ColumnEncoding::frame_of_reference:
+		return math::packed_bytes(chunk.count, chunk.bits);
+	case ColumnEncoding::delta:
+		return math::packed_bytes(chunk.count - 1, chunk.bits);
+	default:
+		return chunk.entries * element_size + math::packed_bytes(chunk.count, chunk.bits);
+	}
+}
+
+}
+
+// writes a column file chunk by chunk, so that only one chunk is in memory.
+// the file is complete after finish(), which the destructor calls if need
+// be, though without a way to report errors.
+template <class T>
+struct ColumnWriter
+{
+	static_assert(std::is_arithmetic<T>::value, "a column holds numbers");
+
+	explicit ColumnWriter(const std::string& _path, size_t _chunk_size = 1 << 16)
+	: path(_path), file(std::fopen(path.c_str(), "wb"), &std::fclose), chunk_size(_chunk_size),
+	  offset(0), size(0)
+	{
+		if (!chunk_size)
+			throw std::invalid_argument("a column needs a positive chunk size");
+		if (!file)
+			throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+		buffer.reserve(chunk_size);
+	}
+
+	ColumnWriter(ColumnWriter&&) = default;
+	ColumnWriter& operator=(ColumnWriter&&) = default;
+
+	~ColumnWriter()
+	{
+		if (file)
+		{
+			try
+			{
+				finish();
+			}
+			catch (...)
+			{
+			}
+		}
+	}
+
+	void push(const T& value)
+	{
+		buffer.push_back(value);
+		if (buffer.size() == chunk_size)
+			flush();
+	}
+
+	void write(const T* values, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i)
+			push(values[i]);
+	}
+
+	// writes the last chunk, the index and the footer and closes the file
+	void finish()
+	{
+		if (!file)
+			throw std::logic_error(path + " is finished already");
+		flush();
+		ColumnFooter footer{};
+		std::memcpy(footer.magic, columnar::magic, sizeof(footer.magic));
+		footer.version = columnar::version;
+		footer.type = columnar::column_type<T>();
+		footer.num_chunks = chunks.size();
+		footer.size = size;
+		put(chunks.data(), chunks.size() * sizeof(ColumnChunk));
+		put(&footer, sizeof(footer));
+		if (std::fclose(file.release()) != 0)
+			throw std::runtime_error("cannot write " + path + ": " + std::strerror(errno));
+	}
+
+private:
+	void flush()
+	{
+		if (buffer.empty())
+			return;
+		auto chunk = columnar::encode(buffer.data(), buffer.size(), payload, scratch,
+			std::is_integral<T>());
+		chunk.offset = offset;
+		put(payload.data(), chunk.bytes);
+		offset += chunk.bytes;
+		size += chunk.count;
+		chunks.push_back(chunk);
+		buffer.clear();
+	}
+
+	void put(const void* data, size_t bytes)
+	{
+		if (bytes && std::fwrite(data, 1, bytes, file.get()) != bytes)
+			throw std::runtime_error("cannot write " + path + ": " + std::strerror(errno));
+	}
+
+	std::string path;
+	std::unique_ptr<FILE, int(*)(FILE*)> file;
+	size_t chunk_size;
+	uint64_t offset;
+	uint64_t size;
+	std::vector<T> buffer;
+	std::vector<uint8_t> payload;
+	std::vector<uint64_t> scratch;
+	std::vector<ColumnChunk> chunks;
+};
+
+// a mapped column file. copies share the mapping and the index, so they are
+// cheap to hand to streams.
+template <class T>
+struct ColumnFile
+{
+	static_assert(std::is_arithmetic<T>::value, "a column holds numbers");
+
+	explicit ColumnFile(const std::string& path) : bytes(MappedVector<uint8_t>(path))
+	{
+		auto fail = [&path](const char* what)
+		{
+			return std::invalid_argument(path + " is not a column file: " + what);
+		};
+		const uint8_t* data = bytes.vec.get();
+		if (bytes.vlen < sizeof(ColumnFooter))
+			throw fail("too short");
+		ColumnFooter footer;
+		std::memcpy(&footer, data + bytes.vlen - sizeof(footer), sizeof(footer));
+		if (std::memcmp(footer.magic, columnar::magic, sizeof(footer.magic)) || footer.version != columnar::version)
+			throw fail("bad magic or version");
+		if (footer.type != columnar::column_type<T>())
+			throw fail("different element type");
+		const auto index_end = bytes.vlen - sizeof(footer);
+		if (footer.num_chunks > index_end / sizeof(ColumnChunk))
+			throw fail("truncated index");
+		const auto index_begin = index_end - footer.num_chunks * sizeof(ColumnChunk);
+
+		auto parsed = std::make_shared<Index>();
+		parsed->chunks.resize(footer.num_chunks);
+		if (footer.num_chunks)
+			std::memcpy(parsed->chunks.data(), data + index_begin, footer.num_chunks * sizeof(ColumnChunk));
+		parsed->starts.push_back(0);
+		for (const auto& chunk : parsed->chunks)
+		{
+			// decoding trusts these, and reads at most 8 bytes past a chunk,
+			// which stay within the index and footer
+			if (chunk.offset > index_begin || chunk.bytes > index_begin - chunk.offset || !chunk.count ||
+				chunk.encoding > ColumnEncoding::dictionary || chunk.bits > math::max_packed_bits ||
+				(chunk.encoding != ColumnEncoding::plain && !std::is_integral<T>::value) ||
+				(chunk.encoding == ColumnEncoding::dictionary && !chunk.entries) ||
+				chunk.bytes != columnar::expected_bytes(chunk, sizeof(T)))
+				throw fail("corrupt chunk");
+			parsed->starts.push_back(parsed->starts.back() + chunk.count);
+		}
+		if (parsed->starts.back() != footer.size)
+			throw fail("chunks do not add up");
+		index = std::move(parsed);
+	}
+
+	size_t size() const
+	{
+		return index->starts.back();
+	}
+
+	size_t num_chunks() const
+	{
+		return index->chunks.size();
+	}
+
+	// bytes in the file
+	size_t file_size() const
+	{
+		return bytes.vlen;
+	}
+
+	const ColumnChunk& chunk(size_t k) const
+	{
+		return index->chunks[k];
+	}
+
+	// index of the first element of chunk k
+	size_t chunk_begin(size_t k) const
+	{
+		return index->starts[k];
+	}
+
+	// the chunk holding element i
+	size_t chunk_of(size_t i) const
+	{
+		return std::upper_bound(index->starts.begin(), index->starts.end(), i) - index->starts.begin() - 1;
+	}
+
+	T min(size_t k) const
+	{
+		return columnar::bound<T>(chunk(k).min);
+	}
+
+	T max(size_t k) const
+	{
+		return columnar::bound<T>(chunk(k).max);
+	}
+
+	// writes the chunk(k).count elements of chunk k to dst
+	void decode(size_t k, T* dst) const
+	{
+		const auto& c = chunk(k);
+		const uint8_t* payload = bytes.vec.get() + c.offset;
+		switch (c.encoding)
+		{
+		case ColumnEncoding::plain:
+			std::memcpy(dst, payload, c.count * sizeof(T));
+			break;
+		case ColumnEncoding::frame_of_reference:
+			unpack(payload, c.bits, c.reference, c.count, [dst](size_t i, const int64_t* values, size_t n)
+			{
+				for (size_t j = 0; j < n; ++j)
+					dst[i + j] = static_cast<T>(values[j]);
+			});
+			break;
+		case ColumnEncoding::delta:
+		{
+			auto value = static_cast<uint64_t>(c.start);
+			dst[0] = static_cast<T>(value);
+			unpack(payload, c.bits, c.reference, c.count - 1, [dst, &value](size_t i, const int64_t* values, size_t n)
+			{
+				for (size_t j = 0; j < n; ++j)
+				{
+					value += static_cast<uint64_t>(values[j]);
+					dst[i + j + 1] = static_cast<T>(value);
+				}
+			});
+			break;
+		}
+		case ColumnEncoding::dictionary:
+		{
+			const auto last = c.entries - 1;
+			unpack(payload + c.entries * sizeof(T), c.bits, 0, c.count, [dst, payload, last](size_t i, const int64_t* values, size_t n)
+			{
+				// a corrupt index must not read past the dictionary
+				for (size_t j = 0; j < n; ++j)
+					std::memcpy(dst + i + j, payload + std::min<uint64_t>(values[j], last) * sizeof(T), sizeof(T));
+			});
+			break;
+		}
+		}
+	}
+
+	Vector<T> read_chunk(size_t k) const
+	{
+		Vector<T> values(chunk(k).count, Uninitialized());
+		decode(k, values.vec.get());
+		return values;
+	}
+
+	// the whole column, decoding the chunks in parallel
+	Vector<T> read(ThreadPool& pool = ThreadPool::global()) const
+	{
+		Vector<T> values(size(), Uninitialized());
+		T* dst = values.vec.get();
+		pool.parallel_for(0, num_chunks(), 1, [this, dst](size_t begin, size_t end)
+		{
+			for (auto k = begin; k < end; ++k)
+				decode(k, dst + chunk_begin(k));
+		});
+		return values;
+	}
+
+private:
+	struct Index
+	{
+		std::vector<ColumnChunk> chunks;
+		// chunk_begin() of every chunk and the size
+		std::vector<size_t> starts;
+	};
+
+	// unpacks a block at a time into the stack, where store(i, values, n)
+	// turns them into elements while they are in L1
+	template <class Store>
+	static void unpack(const uint8_t* packed, unsigned bits, int64_t reference, size_t n, const Store& store)
+	{
+		int64_t block[stream_batch_size];
+		for (size_t i = 0; i < n; i += stream_batch_size)
+		{
+			const auto m = std::min(n - i, stream_batch_size);
+			math::unpack(packed, bits, static_cast<uint64_t>(reference), i, m, block);
+			store(i, block, m);
+		}
+	}
+
+	// the mapping, only ever read through const access, which never copies it
+	const Vector<uint8_t> bytes;
+	std::shared_ptr<const Index> index;
+};
+
+// the elements of a column file, decoded a chunk at a time into a buffer
+// which stays in cache while the pipeline consumes it. splits for the
+// parallel terminals, every part decoding its own chunks.
+template <class T>
+struct ColumnSource
+{
+	using value_type = T;
+
+	explicit ColumnSource(const ColumnFile<T>& _file) : file(_file), index(0), end(file.size()), first(0)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		return pull_batch(1, std::forward<Sink>(sink));
+	}
+
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		if (index == end)
+			return false;
+		if (index < first || index - first >= buffer.size())
+		{
+			const auto k = file.chunk_of(index);
+			buffer.resize(file.chunk(k).count);
+			file.decode(k, buffer.data());
+			first = file.chunk_begin(k);
+		}
+		const auto n = std::min(std::min(max, end - index), first + buffer.size() - index);
+		const T* values = buffer.data() + (index - first);
+		for (size_t i = 0; i < n; ++i)
+			sink(values[i]);
+		index += n;
+		return true;
+	}
+
+	size_t size() const
+	{
+		return end - index;
+	}
+
+	ColumnSource slice(size_t begin, size_t end) const
+	{
+		ColumnSource part(file);
+		part.index = index + begin;
+		part.end = index + end;
+		return part;
+	}
+
+	const ColumnFile<T> file;
+	size_t index;
+	size_t end;
+	// element index of buffer[0]
+	size_t first;
+	std::vector<T> buffer;
+};
+
+template <class T>
+struct is_splittable<ColumnSource<T>> : std::true_type
+{
+};
+
+template <class T>
+struct is_batched<ColumnSource<T>> : std::true_type
+{
+};
+
+namespace Collectors
+{
+
+// writes the elements to a column file and gives the file, opened
+template <class T>
+struct ToColumnFile
+{
+	using combinable = std::false_type;
+
+	template <class U>
+	ColumnWriter<element_t<T,U>> supply() const
+	{
+		return ColumnWriter<element_t<T,U>>(path, chunk_size);
+	}
+
+	template <class E, class U>
+	void accumulate(ColumnWriter<E>& writer, const U& value) const
+	{
+		writer.push(value);
+	}
+
+	template <class E>
+	ColumnFile<E> finish(ColumnWriter<E>&& writer) const
+	{
+		writer.finish();
+		return ColumnFile<E>(path);
+	}
+
+	std::string path;
+	size_t chunk_size;
+};
+
+template <class T = void>
+ToColumnFile<T> to_column_file(const std::string& path, size_t chunk_size = 1 << 16)
+{
+	return ToColumnFile<T>{path, chunk_size};
+}
+
+}
+
+namespace Functional
+{
+
+// writes v as a column file, see ColumnWriter
+template <class T>
+void save_column(const Vector<T>& v, const std::string& path, size_t chunk_size = 1 << 16)
+{
+	ColumnWriter<T> writer(path, chunk_size);
+	writer.write(v.vec.get(), v.vlen);
+	writer.finish();
+}
+
+template <class T>
+Stream<ColumnSource<T>> read_column(const ColumnFile<T>& file)
+{
+	return Stream<ColumnSource<T>>(ColumnSource<T>(file));
+}
+
+// the elements of the chunks [first_chunk, last_chunk), e.g. those whose min
+// and max overlap a range of interest
+template <class T>
+Stream<ColumnSource<T>> read_column(const ColumnFile<T>& file, size_t first_chunk, size_t last_chunk)
+{
+	if (first_chunk > last_chunk || last_chunk > file.num_chunks())
+		throw std::out_of_range("read_column() chunks out of range");
+	return Stream<ColumnSource<T>>(ColumnSource<T>(file).slice(
+		file.chunk_begin(first_chunk), file.chunk_begin(last_chunk)));
+}
+
+template <class T>
+Stream<ColumnSource<T>> read_column(const std::string& path)
+{
+	return read_column(ColumnFile<T>(path));
+}
+
+}
+
+}
+#endif // COLUMNAR_HPP__
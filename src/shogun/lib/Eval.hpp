@@ -34,56 +34,343 @@
 #define EVAL_HPP__
 
 #include <functional>
+#include <memory>
+#include <stdexcept>
+#include <shogun/lib/Allocator.hpp>
+#include <shogun/lib/Mapper.hpp>
+#include <shogun/lib/Collectors.hpp>
+#include <shogun/lib/Reduce.hpp>
+#include <shogun/lib/Slot.hpp>
+#include <shogun/lib/ThreadPool.hpp>
 
 using std::declval;
 
 namespace shogun
 {
 
-template <template <class> class Functor, class A, class B>
+template <template <class> class Functor, class T>
+struct Cached;
+
+// An Eval describes a pending fmap over a functor instance. The mapper type is
+// a template parameter, so every call to map() composes a new mapper type at
+// compile time and yield() runs one fused loop over the source.
+template <template <class> class Functor, class A, class B, class Mapper>
 struct Eval
 {
-	Eval(std::function<B(A)>&& map, const Functor<A>& _f_a) : mapper(map), f_a(_f_a)
+	using mapper_type = Mapper;
+
+	Eval(const Mapper& _mapper, const Functor<A>& _f_a,
+		std::shared_ptr<const Functor<A>> _storage = nullptr)
+	: mapper(_mapper), storage(std::move(_storage)), f_a(&_f_a)
 	{
 	}
 
-	template <class Mapper>
-	Eval<Functor,A,decltype((declval<Mapper>())(declval<B>()))> map(const Mapper& _mapper) const
+	// for sources that were materialized by an earlier stage and are owned by
+	// the pipeline itself
+	Eval(const Mapper& _mapper, std::shared_ptr<const Functor<A>> _storage)
+	: mapper(_mapper), storage(std::move(_storage)), f_a(storage.get())
 	{
-		using C = decltype((declval<Mapper>())(declval<B>()));
-		auto composite_mapper = [this, &_mapper](const A& a)
-		{
-			return std::forward<C>(_mapper(std::forward<B>(mapper(a))));
-		};
-		return Eval<Functor,A,C>(composite_mapper, f_a);
 	}
 
-//	template <class Mapper>
-//	auto bind(const Mapper& mapper) const
-//	{
-//		using NewFunctor = decltype((declval<Mapper>())(declval<B>()));
-//		//
-//	}
+	// for sources that an earlier bind() or filter() computes on first use
+	Eval(const Mapper& _mapper, const Cached<Functor,A>& _pending)
+	: mapper(_mapper), pending(std::make_shared<const Cached<Functor,A>>(_pending)), f_a(nullptr)
+	{
+	}
+
+	// the source of upstream under another mapper
+	template <class C, class Upstream>
+	Eval(const Mapper& _mapper, const Eval<Functor,A,C,Upstream>& upstream)
+	: mapper(_mapper), storage(upstream.storage), pending(upstream.pending), f_a(upstream.f_a)
+	{
+	}
+
+	// the source, computed first if it is the result of a bind() or filter()
+	const Functor<A>& source() const
+	{
+		return pending ? pending->get() : *f_a;
+	}
+
+	template <class NextMapper>
+	Eval<Functor,A,map_result_t<NextMapper,B>,Composite<NextMapper,Mapper>>
+	map(const NextMapper& _mapper) const
+	{
+		using C = map_result_t<NextMapper,B>;
+		using Next = Composite<NextMapper,Mapper>;
+		return Eval<Functor,A,C,Next>(Next(_mapper, mapper), *this);
+	}
 
+	// disambiguates overloaded free functions by their argument type
 	template <class C>
-	Eval<Functor,A,C> map(C(* const _mapper)(const B&)) const
+	Eval<Functor,A,C,Composite<C(*)(const B&),Mapper>> map(C(* const _mapper)(const B&)) const
 	{
-		auto composite_mapper = [this, &_mapper](const A& a)
+		using Next = Composite<C(*)(const B&),Mapper>;
+		return Eval<Functor,A,C,Next>(Next(_mapper, mapper), *this);
+	}
+
+	// (>>=) :: Monad m => m a -> (a -> m b) -> m b
+	// nothing runs until a terminal asks for the result. then the pipeline
+	// so far and the binding mapper run as one fused fmap, and the results
+	// are flattened with a single allocation. later stages map lazily over
+	// the flattened functor, which every copy of the pipeline shares.
+	template <class NextMapper>
+	Eval<Functor,typename map_result_t<NextMapper,B>::value_type,
+		typename map_result_t<NextMapper,B>::value_type,
+		Identity<typename map_result_t<NextMapper,B>::value_type>>
+	bind(const NextMapper& _mapper) const
+	{
+		using C = typename map_result_t<NextMapper,B>::value_type;
+		auto pipeline = *this;
+		return Eval<Functor,C,C,Identity<C>>(Identity<C>(), Cached<Functor,C>([pipeline, _mapper]()
+		{
+			return Functor<C>::join(pipeline.source().fmap(Composite<NextMapper,Mapper>(_mapper, pipeline.mapper)));
+		}));
+	}
+
+	// keeps the elements which satisfy predicate. like bind(), it runs once
+	// a terminal asks for the result: the pipeline so far runs fused with the
+	// compaction, later stages continue over the kept elements only.
+	// comparisons from Math.hpp, e.g. math::Less, are tested a whole SIMD
+	// batch at a time.
+	template <class Predicate>
+	Eval<Functor,B,B,Identity<B>> filter(const Predicate& predicate) const
+	{
+		auto pipeline = *this;
+		return Eval<Functor,B,B,Identity<B>>(Identity<B>(), Cached<Functor,B>([pipeline, predicate]()
 		{
-			return std::forward<C>(_mapper(std::forward<B>(mapper(a))));
-		};
-		return Eval<Functor,A,C>(composite_mapper, f_a);
+			return pipeline.source().filter(pipeline.mapper, predicate);
+		}));
+	}
+
+	// explicit opt-in for type erasure, e.g. to store pipelines of different
+	// shapes in the same container. every element pays an indirect call.
+	Eval<Functor,A,B,std::function<B(A)>> erased() const
+	{
+		return Eval<Functor,A,B,std::function<B(A)>>(mapper, *this);
 	}
 
 	Functor<B> yield() const
 	{
-		return f_a.fmap(mapper);
+		return source().fmap(mapper);
 	}
 
-	const std::function<B(A)> mapper;
-	const Functor<A>& f_a;
+	// same as yield() but the fused mapper runs on the threads of the pool,
+	// so it has to be safe to call concurrently
+	Functor<B> yield_parallel(ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().fmap_parallel(mapper, pool);
+	}
+
+	// destination passing version of yield(), target is only reallocated if
+	// its size does not match the source
+	void yield_into(Functor<B>& target) const
+	{
+		source().fmap_into(mapper, target);
+	}
+
+	void yield_parallel_into(Functor<B>& target, ThreadPool& pool = ThreadPool::global()) const
+	{
+		source().fmap_parallel_into(mapper, target, pool);
+	}
+
+	// yield() for pipelines of tuple like records, stored one column per
+	// field, see Records.hpp
+	auto yield_records() const
+	{
+		return source().fmap_records(mapper);
+	}
+
+	auto yield_records_parallel(ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().fmap_records_parallel(mapper, pool);
+	}
+
+	// the result, computed once on first use and shared by every consumer
+	// from then on, see Cached
+	Cached<Functor,B> cache() const
+	{
+		return persist(nullptr);
+	}
+
+	// the same with the buffer allocated from resource, e.g. huge pages for
+	// a large intermediate which is read many times
+	Cached<Functor,B> persist(MemoryResource* resource) const
+	{
+		auto pipeline = *this;
+		return Cached<Functor,B>([pipeline]() { return pipeline.yield(); }, resource);
+	}
+
+	// a pipeline which owns an output buffer and yields into it on every
+	// yield_reused(). copies of the returned Eval share that buffer.
+	Eval reuse_output() const
+	{
+		Eval reusing(*this);
+		reusing.output = std::make_shared<Functor<B>>();
+		return reusing;
+	}
+
+	// the result stays valid until the next call on this pipeline
+	const Functor<B>& yield_reused() const
+	{
+		if (!output)
+			throw std::logic_error("yield_reused() requires reuse_output()");
+		yield_into(*output);
+		return *output;
+	}
+
+	// short-circuiting terminals map only as many elements as it takes to
+	// know the answer. the parallel ones cancel the other workers as soon as
+	// it is known.
+	template <class Predicate>
+	Slot<B> find_first(const Predicate& predicate) const
+	{
+		return source().find_first(mapper, predicate);
+	}
+
+	template <class Predicate>
+	Slot<B> find_first_parallel(const Predicate& predicate, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().find_first_parallel(mapper, predicate, pool);
+	}
+
+	template <class Predicate>
+	bool any_match(const Predicate& predicate) const
+	{
+		return source().any_match(mapper, predicate);
+	}
+
+	template <class Predicate>
+	bool any_match_parallel(const Predicate& predicate, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().any_match_parallel(mapper, predicate, pool);
+	}
+
+	template <class Predicate>
+	bool all_match(const Predicate& predicate) const
+	{
+		return !any_match(Not<Predicate>{predicate});
+	}
+
+	template <class Predicate>
+	bool all_match_parallel(const Predicate& predicate, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return !any_match_parallel(Not<Predicate>{predicate}, pool);
+	}
+
+	template <class Predicate>
+	bool none_match(const Predicate& predicate) const
+	{
+		return !any_match(predicate);
+	}
+
+	template <class Predicate>
+	bool none_match_parallel(const Predicate& predicate, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return !any_match_parallel(predicate, pool);
+	}
+
+	template <class Predicate>
+	Functor<B> take_while(const Predicate& predicate) const
+	{
+		return source().take_while(mapper, predicate);
+	}
+
+	Functor<B> limit(size_t n) const
+	{
+		return source().limit(mapper, n);
+	}
+
+	// reducing terminals fuse into the map loop and never store the mapped
+	// elements. op has to be associative and commutative.
+	template <class Op, class R>
+	R reduce(const Op& op, R init) const
+	{
+		return source().reduce(mapper, op, init);
+	}
+
+	B sum() const
+	{
+		return reduce(Plus(), B(0));
+	}
+
+	// see Summation for what the modes trade off
+	B sum(Summation mode) const
+	{
+		return source().sum(mapper, mode);
+	}
+
+	// pairwise and compensated sums do not depend on the number of threads
+	B sum_parallel(Summation mode = Summation::pairwise, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().sum_parallel(mapper, mode, pool);
+	}
+
+	// NaN for an empty source
+	double mean() const
+	{
+		return static_cast<double>(sum()) / source().vlen;
+	}
+
+	double mean(Summation mode) const
+	{
+		return static_cast<double>(sum(mode)) / source().vlen;
+	}
+
+	double mean_parallel(Summation mode = Summation::pairwise,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		return static_cast<double>(sum_parallel(mode, pool)) / source().vlen;
+	}
+
+	// +inf (or the largest value) for an empty source
+	B min() const
+	{
+		return reduce(Minimum(), highest<B>());
+	}
+
+	// -inf (or the lowest value) for an empty source
+	B max() const
+	{
+		return reduce(Maximum(), lowest<B>());
+	}
+
+	// inner product of the mapped elements with other
+	B dot(const Functor<B>& other) const
+	{
+		return source().dot(mapper, other);
+	}
+
+	template <class Collector>
+	auto collect(const Collector& collector) const
+	{
+		return source().collect(mapper, collector);
+	}
+
+	// e.g. collect([&c]() { return c; }, &Collector::add)
+	template <class Supplier, class Accumulator>
+	auto collect(const Supplier& supplier, const Accumulator& accumulator) const
+	{
+		return collect(Collectors::of(supplier, accumulator));
+	}
+
+	// the collector has to be able to combine partial results, see Collectors
+	template <class Collector>
+	auto collect_parallel(const Collector& collector, ThreadPool& pool = ThreadPool::global()) const
+	{
+		return source().collect_parallel(mapper, collector, pool);
+	}
+
+	const Mapper mapper;
+	const std::shared_ptr<const Functor<A>> storage;
+	// set for the result of a bind() or filter(), computed by the first
+	// terminal and shared by every copy
+	const std::shared_ptr<const Cached<Functor,A>> pending;
+	const Functor<A>* const f_a;
+	std::shared_ptr<Functor<B>> output;
 };
 
 }
 
+#include <shogun/lib/Cache.hpp>
+
 #endif // EVAL_HPP__
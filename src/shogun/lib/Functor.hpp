@@ -34,6 +34,7 @@
 #define FUNCTOR_HPP__
 
 #include <functional>
+#include <shogun/lib/Mapper.hpp>
 
 namespace shogun
 {
@@ -43,8 +44,8 @@ struct Functor
 {
 	virtual ~Functor() {};
 
-	template <class B>
-	Functor<B> fmap(const std::function<B(A)>&) const;
+	template <class Mapper>
+	Functor<map_result_t<Mapper,A>> fmap(const Mapper&) const;
 };
 
 }
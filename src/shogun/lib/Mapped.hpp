@@ -0,0 +1,229 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAPPED_HPP__
+#define MAPPED_HPP__
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <shogun/lib/Vector.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shogun
+{
+
+enum class Mapping
+{
+	// writes go to a private heap copy of the whole vector, see SharedArray
+	read_only,
+	// writes go to private copies of the touched pages, the file is never
+	// modified
+	private_writable
+};
+
+// access pattern hints, passed on to madvise()
+enum class Advice
+{
+	normal,
+	sequential,
+	random,
+	// start reading ahead now
+	willneed,
+	// drop the pages, e.g. after a pass. writes to a private_writable
+	// mapping are lost.
+	dontneed
+};
+
+// A Vector over the elements of a raw binary file of Ts, mapped into memory
+// rather than read. Opening it costs the same for any file size, the pages
+// are only read when a pipeline gets to them and the kernel may drop them
+// again under memory pressure. It is a Vector, so Functional::evaluate(),
+// fmap() and streams take it as it is, and copies share the mapping.
+template <class T>
+struct MappedVector : public Vector<T>
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+		"a mapped file holds the raw bytes of its elements");
+
+	explicit MappedVector(const std::string& path, Mapping mapping = Mapping::read_only,
+		Advice advice = Advice::normal)
+	: MappedVector(map_file(path, mapping))
+	{
+		advise(advice);
+	}
+
+	// applies to the mapping of elements [begin, end). once writes to a
+	// read_only mapping moved the vector to the heap, the mapping is only
+	// left while copies share it
+	void advise(Advice advice, size_t begin = 0, size_t end = npos) const
+	{
+#ifdef __linux__
+		end = std::min(end, mapped);
+		// keeps the mapping alive meanwhile, if it still is
+		auto mapping = region.lock();
+		if (!mapping || begin >= end)
+			return;
+		const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		auto first = reinterpret_cast<uintptr_t>(mapping.get()) + begin * sizeof(T);
+		auto last = reinterpret_cast<uintptr_t>(mapping.get()) + end * sizeof(T);
+		first -= first % page;
+		if (madvise(reinterpret_cast<void*>(first), last - first, native(advice)) != 0)
+			throw std::runtime_error(std::string("madvise() failed: ") + std::strerror(errno));
+#else
+		(void)advice;
+		(void)begin;
+		(void)end;
+#endif
+	}
+
+	static constexpr size_t npos = static_cast<size_t>(-1);
+
+private:
+	struct File
+	{
+		std::shared_ptr<T> region;
+		size_t size;
+		bool read_only;
+	};
+
+	explicit MappedVector(File file)
+	: Vector<T>(SharedArray<T>(file.region, file.size, file.read_only), file.size),
+	  region(file.region), mapped(file.size)
+	{
+	}
+
+	static File map_file(const std::string& path, Mapping mapping)
+	{
+#ifdef __linux__
+		auto fail = [&path](const char* what)
+		{
+			return std::runtime_error(std::string(what) + " " + path + ": " + std::strerror(errno));
+		};
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw fail("cannot open");
+		struct stat info;
+		if (fstat(fd, &info) != 0)
+		{
+			auto error = fail("cannot stat");
+			close(fd);
+			throw error;
+		}
+		const auto bytes = static_cast<size_t>(info.st_size);
+		if (bytes % sizeof(T) != 0)
+		{
+			close(fd);
+			throw std::invalid_argument(path + " is not a whole number of elements");
+		}
+		const bool read_only = mapping == Mapping::read_only;
+		void* p = nullptr;
+		if (bytes)
+		{
+			p = mmap(nullptr, bytes, read_only ? PROT_READ : PROT_READ | PROT_WRITE,
+				MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED)
+			{
+				auto error = fail("cannot map");
+				close(fd);
+				throw error;
+			}
+		}
+		// the mapping keeps the file open
+		close(fd);
+		if (!p)
+			return File{nullptr, 0, read_only};
+		std::shared_ptr<T> region(static_cast<T*>(p), [bytes](T* q) { munmap(q, bytes); });
+		return File{std::move(region), bytes / sizeof(T), read_only};
+#else
+		(void)mapping;
+		throw std::runtime_error("cannot map " + path + ": not supported on this platform");
+#endif
+	}
+
+#ifdef __linux__
+	static int native(Advice advice)
+	{
+		switch (advice)
+		{
+		case Advice::sequential:
+			return MADV_SEQUENTIAL;
+		case Advice::random:
+			return MADV_RANDOM;
+		case Advice::willneed:
+			return MADV_WILLNEED;
+		case Advice::dontneed:
+			return MADV_DONTNEED;
+		default:
+			return MADV_NORMAL;
+		}
+	}
+#endif
+
+	// the whole mapping, whatever the vector points to by now. it does not
+	// own it, so that a private_writable mapping which is not shared counts
+	// as unique and is written in place
+	std::weak_ptr<T> region;
+	size_t mapped;
+};
+
+namespace Functional
+{
+
+// writes the elements of v as a raw binary file which MappedVector can map
+template <class T>
+void save_raw(const Vector<T>& v, const std::string& path)
+{
+	static_assert(std::is_trivially_copyable<T>::value,
+		"a raw file holds the bytes of its elements");
+	std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+	if (!file)
+		throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+	if (v.vlen && std::fwrite(v.vec.get(), sizeof(T), v.vlen, file.get()) != v.vlen)
+		throw std::runtime_error("cannot write " + path + ": " + std::strerror(errno));
+}
+
+}
+
+}
+#endif // MAPPED_HPP__
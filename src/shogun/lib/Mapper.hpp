@@ -0,0 +1,109 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MAPPER_HPP__
+#define MAPPER_HPP__
+
+#include <utility>
+#include <type_traits>
+
+namespace shogun
+{
+
+// the value type produced by applying a mapper to an A
+template <class Mapper, class A>
+using map_result_t = typename std::decay<
+	decltype((std::declval<const Mapper&>())(std::declval<const A&>()))>::type;
+
+// id :: a -> a
+template <class A>
+struct Identity
+{
+	const A& operator()(const A& a) const
+	{
+		return a;
+	}
+};
+
+// (.) :: (b -> c) -> (a -> b) -> a -> c
+// both stages are stored by value and their types are part of the composite
+// type, so a chain of maps collapses into a single inlinable call.
+template <class Outer, class Inner>
+struct Composite
+{
+	Composite(const Outer& _outer, const Inner& _inner) : outer(_outer), inner(_inner)
+	{
+	}
+
+	template <class A>
+	auto operator()(A&& a) const -> decltype((std::declval<const Outer&>())(
+		(std::declval<const Inner&>())(std::forward<A>(a))))
+	{
+		return outer(inner(std::forward<A>(a)));
+	}
+
+	Outer outer;
+	Inner inner;
+};
+
+// composing with the identity is a no-op
+template <class Outer, class A>
+struct Composite<Outer, Identity<A>>
+{
+	Composite(const Outer& _outer, const Identity<A>&) : outer(_outer)
+	{
+	}
+
+	template <class X>
+	auto operator()(X&& x) const -> decltype((std::declval<const Outer&>())(std::forward<X>(x)))
+	{
+		return outer(std::forward<X>(x));
+	}
+
+	Outer outer;
+};
+
+// negates a predicate, e.g. all_match(p) is !any_match(Not<P>{p})
+template <class Predicate>
+struct Not
+{
+	template <class X>
+	bool operator()(const X& x) const
+	{
+		return !predicate(x);
+	}
+
+	Predicate predicate;
+};
+
+}
+#endif // MAPPER_HPP__
@@ -0,0 +1,434 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MATH_HPP__
+#define MATH_HPP__
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <shogun/lib/Mapper.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHOGUN_HAVE_X86_SIMD 1
+#endif
+
+namespace shogun
+{
+
+namespace math
+{
+
+// Elementwise operators on doubles. Pipelines built only out of these (see
+// is_vectorizable) are lowered by transform() to batch kernels for the best
+// instruction set the cpu supports. Called one element at a time they simply
+// forward to the standard library. The kernels of Exp, Log, Sin and Cos stay
+// within 2 ulp of it, which the kernel_accuracy benchmark checks.
+struct VectorizableOp
+{
+};
+
+struct Sqrt : VectorizableOp
+{
+	double operator()(double x) const { return std::sqrt(x); }
+};
+
+struct Exp : VectorizableOp
+{
+	double operator()(double x) const { return std::exp(x); }
+};
+
+struct Log : VectorizableOp
+{
+	double operator()(double x) const { return std::log(x); }
+};
+
+struct Sin : VectorizableOp
+{
+	double operator()(double x) const { return std::sin(x); }
+};
+
+struct Cos : VectorizableOp
+{
+	double operator()(double x) const { return std::cos(x); }
+};
+
+struct Add : VectorizableOp
+{
+	explicit Add(double _c) : c(_c) {}
+	double operator()(double x) const { return x + c; }
+	double c;
+};
+
+struct Sub : VectorizableOp
+{
+	explicit Sub(double _c) : c(_c) {}
+	double operator()(double x) const { return x - c; }
+	double c;
+};
+
+struct Mul : VectorizableOp
+{
+	explicit Mul(double _c) : c(_c) {}
+	double operator()(double x) const { return x * c; }
+	double c;
+};
+
+struct Div : VectorizableOp
+{
+	explicit Div(double _c) : c(_c) {}
+	double operator()(double x) const { return x / c; }
+	double c;
+};
+
+struct Clamp : VectorizableOp
+{
+	Clamp(double _lo, double _hi) : lo(_lo), hi(_hi) {}
+	double operator()(double x) const { return x < lo ? lo : (hi < x ? hi : x); }
+	double lo;
+	double hi;
+};
+
+// x -> a * x + b
+struct FMA : VectorizableOp
+{
+	FMA(double _a, double _b) : a(_a), b(_b) {}
+	double operator()(double x) const { return a * x + b; }
+	double a;
+	double b;
+};
+
+// Comparisons of doubles for filter(). compress() evaluates them a whole
+// batch at a time into a mask and compacts the batch without branching on it.
+struct VectorizablePredicate
+{
+};
+
+struct Less : VectorizablePredicate
+{
+	explicit Less(double _c) : c(_c) {}
+	bool operator()(double x) const { return x < c; }
+	double c;
+};
+
+struct LessEqual : VectorizablePredicate
+{
+	explicit LessEqual(double _c) : c(_c) {}
+	bool operator()(double x) const { return x <= c; }
+	double c;
+};
+
+struct Greater : VectorizablePredicate
+{
+	explicit Greater(double _c) : c(_c) {}
+	bool operator()(double x) const { return x > c; }
+	double c;
+};
+
+struct GreaterEqual : VectorizablePredicate
+{
+	explicit GreaterEqual(double _c) : c(_c) {}
+	bool operator()(double x) const { return x >= c; }
+	double c;
+};
+
+// lo <= x < hi
+struct Between : VectorizablePredicate
+{
+	Between(double _lo, double _hi) : lo(_lo), hi(_hi) {}
+	bool operator()(double x) const { return lo <= x && x < hi; }
+	double lo;
+	double hi;
+};
+
+template <class Mapper>
+struct is_vectorizable : std::is_base_of<VectorizableOp, Mapper>
+{
+};
+
+template <class Outer, class Inner>
+struct is_vectorizable<Composite<Outer,Inner>> : std::integral_constant<bool,
+	is_vectorizable<Outer>::value && is_vectorizable<Inner>::value>
+{
+};
+
+template <class Outer, class A>
+struct is_vectorizable<Composite<Outer,Identity<A>>> : is_vectorizable<Outer>
+{
+};
+
+// whether mapping As to Bs with mapper can run through the batch kernels
+template <class Mapper, class A, class B>
+struct is_lowerable : std::integral_constant<bool, is_vectorizable<Mapper>::value
+	&& std::is_arithmetic<A>::value && std::is_same<B,double>::value>
+{
+};
+
+template <class Predicate, class B>
+struct is_compressible : std::integral_constant<bool,
+	std::is_base_of<VectorizablePredicate, Predicate>::value && std::is_same<B,double>::value>
+{
+};
+
+// instruction sets the batch kernels are compiled for
+enum class SIMD
+{
+	none,
+	sse4,
+	avx2,
+	avx512
+};
+
+inline SIMD detect_simd()
+{
+#ifdef SHOGUN_HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+		return SIMD::avx512;
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return SIMD::avx2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return SIMD::sse4;
+	return SIMD::none;
+#else
+	return SIMD::none;
+#endif
+}
+
+// the instruction set transform() dispatches to. it is detected on first use
+// and may be lowered afterwards, e.g. to compare the kernels with each other.
+inline SIMD& simd_level()
+{
+	static SIMD level = detect_simd();
+	return level;
+}
+
+// polynomial coefficients of the Cephes approximations used by the kernels
+namespace cephes
+{
+constexpr double exp_p[] = {
+	1.26177193074810590878E-4, 3.02994407707441961300E-2, 9.99999999999999999910E-1 };
+constexpr double exp_q[] = {
+	3.00198505138664455042E-6, 2.52448340349684104192E-3, 2.27265548208155028766E-1,
+	2.00000000000000000009E0 };
+constexpr double log_p[] = {
+	1.01875663804580931796E-4, 4.97494994976747001425E-1, 4.70579119878881725854E0,
+	1.44989225341610930846E1, 1.79368678507819816313E1, 7.70838733755885391666E0 };
+constexpr double log_q[] = {
+	1.0, 1.12873587189167450590E1, 4.52279145837532221105E1, 8.29875266912776603211E1,
+	7.11544750618563894466E1, 2.31251620126765340583E1 };
+constexpr double sin_p[] = {
+	1.58962301576546568060E-10, -2.50507477628578072866E-8, 2.75573136213857245213E-6,
+	-1.98412698295895385996E-4, 8.33333333332211858878E-3, -1.66666666666666307295E-1 };
+constexpr double cos_p[] = {
+	-1.13585365213876817300E-11, 2.08757008419747316778E-9, -2.75573141792967388112E-7,
+	2.48015872888517045348E-5, -1.38888888888730564116E-3, 4.16666666666665929218E-2 };
+}
+
+#ifdef SHOGUN_HAVE_X86_SIMD
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+#define SHOGUN_SIMD_NAMESPACE sse4
+#define SHOGUN_SIMD_BYTES 16
+#include <shogun/lib/MathKernels.hpp>
+#undef SHOGUN_SIMD_BYTES
+#undef SHOGUN_SIMD_NAMESPACE
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define SHOGUN_SIMD_NAMESPACE avx2
+#define SHOGUN_SIMD_BYTES 32
+#include <shogun/lib/MathKernels.hpp>
+#undef SHOGUN_SIMD_BYTES
+#undef SHOGUN_SIMD_NAMESPACE
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512dq")
+#define SHOGUN_SIMD_NAMESPACE avx512
+#define SHOGUN_SIMD_BYTES 64
+#include <shogun/lib/MathKernels.hpp>
+#undef SHOGUN_SIMD_BYTES
+#undef SHOGUN_SIMD_NAMESPACE
+#pragma GCC pop_options
+
+#endif // SHOGUN_HAVE_X86_SIMD
+
+template <class Mapper, class A, class B>
+void transform(const Mapper& mapper, const A* src, B* dst, size_t n, std::false_type)
+{
+	for (size_t i = 0; i < n; ++i)
+		dst[i] = mapper(src[i]);
+}
+
+template <class Mapper, class A>
+void transform(const Mapper& mapper, const A* src, double* dst, size_t n, std::true_type)
+{
+	switch (simd_level())
+	{
+#ifdef SHOGUN_HAVE_X86_SIMD
+	case SIMD::avx512:
+		return avx512::transform(mapper, src, dst, n);
+	case SIMD::avx2:
+		return avx2::transform(mapper, src, dst, n);
+	case SIMD::sse4:
+		return sse4::transform(mapper, src, dst, n);
+#endif
+	default:
+		return transform(mapper, src, dst, n, std::false_type());
+	}
+}
+
+// dst[i] = mapper(src[i]) for i in [0, n), through the batch kernels whenever
+// the mapper is a composition of the vectorizable operators above
+template <class Mapper, class A, class B>
+void transform(const Mapper& mapper, const A* src, B* dst, size_t n)
+{
+	transform(mapper, src, dst, n, is_lowerable<Mapper,A,B>());
+}
+
+// every element is written and the output position only advances past the
+// selected ones, so there is no branch on the outcome of the predicate
+template <class Predicate, class B>
+size_t compress(const Predicate& predicate, const B* src, B* dst, size_t n, std::false_type, std::true_type)
+{
+	size_t k = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		dst[k] = src[i];
+		k += predicate(src[i]) ? 1 : 0;
+	}
+	return k;
+}
+
+// elements which are expensive to copy are only copied when selected
+template <class Predicate, class B>
+size_t compress(const Predicate& predicate, const B* src, B* dst, size_t n, std::false_type, std::false_type)
+{
+	size_t k = 0;
+	for (size_t i = 0; i < n; ++i)
+		if (predicate(src[i]))
+			dst[k++] = src[i];
+	return k;
+}
+
+template <class Predicate>
+size_t compress(const Predicate& predicate, const double* src, double* dst, size_t n, std::true_type, std::true_type)
+{
+	switch (simd_level())
+	{
+#ifdef SHOGUN_HAVE_X86_SIMD
+	case SIMD::avx512:
+		return avx512::compress(predicate, src, dst, n);
+	case SIMD::avx2:
+		return avx2::compress(predicate, src, dst, n);
+	case SIMD::sse4:
+		return sse4::compress(predicate, src, dst, n);
+#endif
+	default:
+		return compress(predicate, src, dst, n, std::false_type(), std::true_type());
+	}
+}
+
+// copies the elements of [src, src + n) which satisfy predicate to the front
+// of dst, in order, and returns how many there are. dst has room for n
+// elements and may only be src itself, i.e. compaction in place.
+template <class Predicate, class B>
+size_t compress(const Predicate& predicate, const B* src, B* dst, size_t n)
+{
+	return compress(predicate, src, dst, n, is_compressible<Predicate,B>(),
+		std::is_trivially_copyable<B>());
+}
+
+// bit packing of integers, e.g. offsets from a frame of reference. value i
+// takes the bits [i * bits, (i + 1) * bits) of the array, least significant
+// first. bits is at most 56, so that a value fits into one unaligned 64 bit
+// load with any bit offset.
+constexpr unsigned max_packed_bits = 56;
+
+inline size_t packed_bytes(size_t n, unsigned bits)
+{
+	return (n * bits + 7) / 8;
+}
+
+// packs values[i] < 2^bits into packed, which has to be zero and have 8 bytes
+// of room after packed_bytes(n, bits)
+inline void pack(const uint64_t* values, size_t n, unsigned bits, uint8_t* packed)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		const uint64_t position = i * bits;
+		uint64_t word;
+		std::memcpy(&word, packed + (position >> 3), sizeof(word));
+		word |= values[i] << (position & 7);
+		std::memcpy(packed + (position >> 3), &word, sizeof(word));
+	}
+}
+
+// dst[i] = value first + i plus reference, wrapping around, for i in [0, n).
+// reads up to 8 bytes past packed_bytes(first + n, bits).
+inline void unpack(const uint8_t* packed, unsigned bits, uint64_t reference, size_t first, size_t n, int64_t* dst)
+{
+	switch (simd_level())
+	{
+#ifdef SHOGUN_HAVE_X86_SIMD
+	case SIMD::avx512:
+		return avx512::unpack(packed, bits, reference, first, n, dst);
+	case SIMD::avx2:
+		return avx2::unpack(packed, bits, reference, first, n, dst);
+	case SIMD::sse4:
+		return sse4::unpack(packed, bits, reference, first, n, dst);
+#endif
+	default:
+		break;
+	}
+	const uint64_t mask = (uint64_t(1) << bits) - 1;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const uint64_t position = (first + i) * bits;
+		uint64_t word;
+		std::memcpy(&word, packed + (position >> 3), sizeof(word));
+		dst[i] = static_cast<int64_t>(((word >> (position & 7)) & mask) + reference);
+	}
+}
+
+}
+
+}
+#endif // MATH_HPP__
@@ -0,0 +1,436 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Batch kernels for the operators in Math.hpp. This file has no include guard
+// on purpose: Math.hpp includes it once per instruction set, inside the
+// matching "#pragma GCC target" region, with SHOGUN_SIMD_NAMESPACE and
+// SHOGUN_SIMD_BYTES defined. The code itself is written against GCC vector
+// extensions, so the same source compiles to every register width.
+
+namespace SHOGUN_SIMD_NAMESPACE
+{
+
+constexpr size_t width = SHOGUN_SIMD_BYTES / sizeof(double);
+typedef double V __attribute__((vector_size(SHOGUN_SIMD_BYTES)));
+typedef int64_t VI __attribute__((vector_size(SHOGUN_SIMD_BYTES)));
+
+// 1.5 * 2^52, adding and subtracting it rounds to the nearest integer and
+// leaves that integer in the low mantissa bits
+constexpr double magic = 6755399441055744.0;
+constexpr int64_t magic_bits = 0x4338000000000000LL;
+constexpr int64_t sign_mask = static_cast<int64_t>(0x8000000000000000ULL);
+
+inline V broadcast(double x)
+{
+	return V{} + x;
+}
+
+inline bool all(VI mask)
+{
+	int64_t acc = -1;
+	for (size_t l = 0; l < width; ++l)
+		acc &= mask[l];
+	return acc != 0;
+}
+
+template <class A>
+inline V load(const A* src)
+{
+	V v = {};
+	for (size_t l = 0; l < width; ++l)
+		v[l] = static_cast<double>(src[l]);
+	return v;
+}
+
+inline void store(double* dst, V v)
+{
+	std::memcpy(dst, &v, sizeof(V));
+}
+
+// only for integral values with magnitude below 2^51
+inline V round_nearest(V x)
+{
+	return (x + magic) - magic;
+}
+
+inline V floor_positive(V x)
+{
+	V r = round_nearest(x);
+	return r > x ? r - 1.0 : r;
+}
+
+inline VI to_int(V integral)
+{
+	return (VI)(integral + magic) - magic_bits;
+}
+
+inline V from_int(VI i)
+{
+	return (V)(i + magic_bits) - magic;
+}
+
+inline V abs(V x)
+{
+	return (V)((VI)x & ~sign_mask);
+}
+
+inline V sqrt(V x)
+{
+#if SHOGUN_SIMD_BYTES == 64
+	return _mm512_maskz_sqrt_pd(static_cast<__mmask8>(-1), x);
+#elif SHOGUN_SIMD_BYTES == 32
+	return _mm256_sqrt_pd(x);
+#else
+	return _mm_sqrt_pd(x);
+#endif
+}
+
+template <size_t N>
+inline V polevl(V x, const double (&c)[N])
+{
+	V r = broadcast(c[0]);
+	for (size_t i = 1; i < N; ++i)
+		r = r * x + c[i];
+	return r;
+}
+
+// lanes the polynomial approximations do not cover (non finite values, huge
+// arguments, denormals) are rare, so the whole batch falls back to libm
+template <class Op>
+inline V lanewise(const Op& op, V x)
+{
+	V r = {};
+	for (size_t l = 0; l < width; ++l)
+		r[l] = op(x[l]);
+	return r;
+}
+
+inline V eval(const Sqrt&, V x)
+{
+	return sqrt(x);
+}
+
+inline V eval(const Exp& op, V x)
+{
+	if (!all((x > -708.0) & (x < 708.0)))
+		return lanewise(op, x);
+	V px = round_nearest(x * 1.4426950408889634073599);
+	VI n = to_int(px);
+	x = x - px * 6.93145751953125E-1;
+	x = x - px * 1.42860682030941723212E-6;
+	V xx = x * x;
+	V p = x * polevl(xx, cephes::exp_p);
+	x = p / (polevl(xx, cephes::exp_q) - p);
+	x = 1.0 + 2.0 * x;
+	return x * (V)((n + 1023) << 52);
+}
+
+inline V eval(const Log& op, V x)
+{
+	if (!all((x >= std::numeric_limits<double>::min()) & (x <= std::numeric_limits<double>::max())))
+		return lanewise(op, x);
+	VI bits = (VI)x;
+	VI e = (bits >> 52) - 1022;
+	// mantissa scaled to [0.5, 1)
+	V m = (V)((bits & 0x000FFFFFFFFFFFFFLL) | 0x3FE0000000000000LL);
+	VI below_sqrth = m < 0.70710678118654752440;
+	e = e + below_sqrth;
+	x = (below_sqrth ? m + m : m) - 1.0;
+	V z = x * x;
+	V y = x * (z * polevl(x, cephes::log_p) / polevl(x, cephes::log_q));
+	V fe = from_int(e);
+	y = y - fe * 2.121944400546905827679e-4;
+	y = y - 0.5 * z;
+	return x + y + fe * 0.693359375;
+}
+
+// Cody-Waite reduction by pi/4 into octant j and remainder z
+inline void reduce_octant(V ax, V& z, VI& j)
+{
+	V y = floor_positive(ax * 1.27323954473516268615);
+	j = to_int(y);
+	VI odd = j & 1;
+	j = (j + odd) & 7;
+	y = y + from_int(odd);
+	z = ((ax - y * 7.85398125648498535156E-1) - y * 3.77489470793079817668E-8)
+		- y * 2.69515142907905952645E-15;
+}
+
+inline V sin_poly(V z, V zz)
+{
+	return z + z * (zz * polevl(zz, cephes::sin_p));
+}
+
+inline V cos_poly(V zz)
+{
+	return 1.0 - 0.5 * zz + zz * zz * polevl(zz, cephes::cos_p);
+}
+
+// beyond this the reduction loses precision, larger arguments go to libm
+constexpr double sincos_max_argument = 268435456.0;
+
+inline V eval(const Sin& op, V x)
+{
+	V ax = abs(x);
+	if (!all(ax < sincos_max_argument))
+		return lanewise(op, x);
+	V z;
+	VI j;
+	reduce_octant(ax, z, j);
+	VI sign = (VI)x & sign_mask;
+	VI upper = j > 3;
+	sign ^= upper & sign_mask;
+	j = upper ? j - 4 : j;
+	V zz = z * z;
+	V r = ((j == 1) | (j == 2)) ? cos_poly(zz) : sin_poly(z, zz);
+	return (V)((VI)r ^ sign);
+}
+
+inline V eval(const Cos& op, V x)
+{
+	V ax = abs(x);
+	if (!all(ax < sincos_max_argument))
+		return lanewise(op, x);
+	V z;
+	VI j;
+	reduce_octant(ax, z, j);
+	VI upper = j > 3;
+	VI sign = upper & sign_mask;
+	j = upper ? j - 4 : j;
+	sign ^= (j > 1) & sign_mask;
+	V zz = z * z;
+	V r = ((j == 1) | (j == 2)) ? sin_poly(z, zz) : cos_poly(zz);
+	return (V)((VI)r ^ sign);
+}
+
+inline V eval(const Add& op, V x)
+{
+	return x + op.c;
+}
+
+inline V eval(const Sub& op, V x)
+{
+	return x - op.c;
+}
+
+inline V eval(const Mul& op, V x)
+{
+	return x * op.c;
+}
+
+inline V eval(const Div& op, V x)
+{
+	return x / op.c;
+}
+
+inline V eval(const Clamp& op, V x)
+{
+	V lo = broadcast(op.lo);
+	V hi = broadcast(op.hi);
+	x = x < lo ? lo : x;
+	return hi < x ? hi : x;
+}
+
+inline V eval(const FMA& op, V x)
+{
+	return op.a * x + op.b;
+}
+
+template <class Outer, class Inner>
+inline V eval(const Composite<Outer,Inner>& mapper, V x);
+
+template <class Outer, class A>
+inline V eval(const Composite<Outer,Identity<A>>& mapper, V x)
+{
+	return eval(mapper.outer, x);
+}
+
+template <class Outer, class Inner>
+inline V eval(const Composite<Outer,Inner>& mapper, V x)
+{
+	return eval(mapper.outer, eval(mapper.inner, x));
+}
+
+inline VI test(const Less& p, V x)
+{
+	return x < p.c;
+}
+
+inline VI test(const LessEqual& p, V x)
+{
+	return x <= p.c;
+}
+
+inline VI test(const Greater& p, V x)
+{
+	return x > p.c;
+}
+
+inline VI test(const GreaterEqual& p, V x)
+{
+	return x >= p.c;
+}
+
+inline VI test(const Between& p, V x)
+{
+	return (x >= p.lo) & (x < p.hi);
+}
+
+#if SHOGUN_SIMD_BYTES == 32
+// for every 4 bit mask, the 32 bit lanes which move the selected doubles to
+// the front of the register
+struct CompressTable
+{
+	CompressTable()
+	{
+		for (int mask = 0; mask < 16; ++mask)
+		{
+			int k = 0;
+			for (int l = 0; l < 4; ++l)
+			{
+				if (mask & (1 << l))
+				{
+					lanes[mask][2 * k] = 2 * l;
+					lanes[mask][2 * k + 1] = 2 * l + 1;
+					++k;
+				}
+			}
+			for (; k < 4; ++k)
+				lanes[mask][2 * k] = lanes[mask][2 * k + 1] = 0;
+		}
+	}
+
+	alignas(32) int32_t lanes[16][8];
+};
+#endif
+
+// stores the lanes of x selected by mask to the front of dst and returns
+// how many there are. dst needs room for a whole register.
+inline size_t compress_store(double* dst, V x, VI mask)
+{
+#if SHOGUN_SIMD_BYTES == 64
+	__mmask8 m = _mm512_movepi64_mask((__m512i)mask);
+	_mm512_mask_compressstoreu_pd(dst, m, x);
+	return __builtin_popcount(m);
+#elif SHOGUN_SIMD_BYTES == 32
+	static const CompressTable table;
+	int m = _mm256_movemask_pd((__m256d)mask);
+	__m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(table.lanes[m]));
+	_mm256_storeu_pd(dst, _mm256_castps_pd(_mm256_permutevar8x32_ps(_mm256_castpd_ps(x), lanes)));
+	return __builtin_popcount(m);
+#else
+	// lanes of a mask are either 0 or -1
+	size_t k = 0;
+	for (size_t l = 0; l < width; ++l)
+	{
+		dst[k] = x[l];
+		k -= mask[l];
+	}
+	return k;
+#endif
+}
+
+template <class Predicate>
+size_t compress(const Predicate& predicate, const double* src, double* dst, size_t n)
+{
+	size_t k = 0;
+	size_t i = 0;
+	for (; i + width <= n; i += width)
+	{
+		V x = load(src + i);
+		k += compress_store(dst + k, x, test(predicate, x));
+	}
+	for (; i < n; ++i)
+	{
+		dst[k] = src[i];
+		k += predicate(src[i]) ? 1 : 0;
+	}
+	return k;
+}
+
+typedef uint64_t VU __attribute__((vector_size(SHOGUN_SIMD_BYTES)));
+
+// the 8 bytes at base + offsets[l] for every lane
+inline VU gather(const uint8_t* base, VU offsets)
+{
+#if SHOGUN_SIMD_BYTES == 64
+	return (VU)_mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, (__m512i)offsets, base, 1);
+#elif SHOGUN_SIMD_BYTES == 32
+	return (VU)_mm256_i64gather_epi64(reinterpret_cast<const long long*>(base), (__m256i)offsets, 1);
+#else
+	VU words;
+	for (size_t l = 0; l < width; ++l)
+		std::memcpy(&words[l], base + offsets[l], sizeof(uint64_t));
+	return words;
+#endif
+}
+
+inline void unpack(const uint8_t* packed, unsigned bits, uint64_t reference, size_t first, size_t n, int64_t* dst)
+{
+	const uint64_t mask = (uint64_t(1) << bits) - 1;
+	VU lanes;
+	for (size_t l = 0; l < width; ++l)
+		lanes[l] = l * bits;
+	size_t i = 0;
+	for (; i + width <= n; i += width)
+	{
+		const VU position = lanes + (first + i) * bits;
+		const VU values = ((gather(packed, position >> 3) >> (position & 7)) & mask) + reference;
+		std::memcpy(dst + i, &values, sizeof(VU));
+	}
+	for (; i < n; ++i)
+	{
+		const uint64_t position = (first + i) * bits;
+		uint64_t word;
+		std::memcpy(&word, packed + (position >> 3), sizeof(word));
+		dst[i] = static_cast<int64_t>(((word >> (position & 7)) & mask) + reference);
+	}
+}
+
+template <class Mapper, class A>
+void transform(const Mapper& mapper, const A* src, double* dst, size_t n)
+{
+	size_t i = 0;
+	for (; i + width <= n; i += width)
+		store(dst + i, eval(mapper, load(src + i)));
+	if (i < n)
+	{
+		A in[width];
+		double out[width];
+		std::fill(in, in + width, static_cast<A>(1));
+		std::copy(src + i, src + n, in);
+		store(out, eval(mapper, load(in)));
+		std::copy(out, out + (n - i), dst + i);
+	}
+}
+
+}
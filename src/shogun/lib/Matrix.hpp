@@ -0,0 +1,252 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MATRIX_HPP__
+#define MATRIX_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <shogun/lib/Allocator.hpp>
+#include <shogun/lib/Collection.hpp>
+#include <shogun/lib/Stream.hpp>
+#include <shogun/lib/View.hpp>
+
+namespace shogun
+{
+
+namespace Functional
+{
+
+// streams of views into a matrix, which never copy an element. the streams
+// are over index ranges, so they split for the parallel terminals.
+
+template <class T>
+auto col_stream(const MatrixView<T>& m)
+{
+	return range<size_t>(0, m.num_cols).map([m](size_t j) { return m.col(j); });
+}
+
+template <class T>
+auto row_stream(const MatrixView<T>& m)
+{
+	return range<size_t>(0, m.num_rows).map([m](size_t i) { return m.row(i); });
+}
+
+// the rows x cols blocks in column major order, those at the bottom and
+// right edge may be smaller
+template <class T>
+auto block_stream(const MatrixView<T>& m, size_t rows, size_t cols)
+{
+	if (rows == 0 || cols == 0)
+		throw std::invalid_argument("block size has to be positive");
+	const auto block_rows = (m.num_rows + rows - 1) / rows;
+	const auto block_cols = (m.num_cols + cols - 1) / cols;
+	return range<size_t>(0, block_rows * block_cols).map([m, rows, cols, block_rows](size_t k)
+	{
+		return m.block(k % block_rows * rows, k / block_rows * cols, rows, cols);
+	});
+}
+
+// the size x size blocks along the diagonal, e.g. for per block statistics
+// of a kernel matrix
+template <class T>
+auto diagonal_block_stream(const MatrixView<T>& m, size_t size)
+{
+	if (size == 0)
+		throw std::invalid_argument("block size has to be positive");
+	const auto num_blocks = (std::min(m.num_rows, m.num_cols) + size - 1) / size;
+	return range<size_t>(0, num_blocks).map([m, size](size_t k) { return m.diagonal_block(k, size); });
+}
+
+}
+
+// dense num_rows x num_cols matrix, stored column by column like SGMatrix, so
+// that a column is contiguous. iterating the collection visits the elements
+// in storage order.
+template <class T>
+struct Matrix : public Collection<T>
+{
+	using iterator_type = typename Collection<T>::iterator_type;
+
+	Matrix() : num_rows(0), num_cols(0)
+	{
+	}
+
+	// elements are value-initialized, i.e. zero for arithmetic types
+	Matrix(size_t rows, size_t cols, MemoryResource* resource = default_resource())
+	: matrix(allocate_array<T>(rows * cols, resource, true)), num_rows(rows), num_cols(cols)
+	{
+	}
+
+	// default-initialized elements, i.e. indeterminate for arithmetic types
+	Matrix(size_t rows, size_t cols, Uninitialized, MemoryResource* resource = default_resource())
+	: matrix(allocate_array<T>(rows * cols, resource, false)), num_rows(rows), num_cols(cols)
+	{
+	}
+
+	Matrix(Matrix&& other)
+	: matrix(std::move(other.matrix)), num_rows(other.num_rows), num_cols(other.num_cols)
+	{
+		other.num_rows = other.num_cols = 0;
+	}
+
+	Matrix& operator=(Matrix&& other)
+	{
+		matrix = std::move(other.matrix);
+		num_rows = other.num_rows;
+		num_cols = other.num_cols;
+		other.num_rows = other.num_cols = 0;
+		return *this;
+	}
+
+	virtual ~Matrix() {}
+
+	virtual iterator_type begin() override
+	{
+		return iterator_type(matrix.get());
+	}
+
+	virtual iterator_type end() override
+	{
+		return iterator_type(matrix.get() + size());
+	}
+
+	virtual iterator_type begin() const override
+	{
+		return iterator_type(matrix.get());
+	}
+
+	virtual iterator_type end() const override
+	{
+		return iterator_type(matrix.get() + size());
+	}
+
+	size_t size() const
+	{
+		return num_rows * num_cols;
+	}
+
+	T& operator()(size_t i, size_t j)
+	{
+		return matrix[i + j * num_rows];
+	}
+
+	const T& operator()(size_t i, size_t j) const
+	{
+		return matrix[i + j * num_rows];
+	}
+
+	MatrixView<T> view()
+	{
+		return MatrixView<T>(matrix.get(), num_rows, num_cols, num_rows);
+	}
+
+	MatrixView<const T> view() const
+	{
+		return MatrixView<const T>(matrix.get(), num_rows, num_cols, num_rows);
+	}
+
+	VectorView<T> col(size_t j)
+	{
+		return view().col(j);
+	}
+
+	VectorView<const T> col(size_t j) const
+	{
+		return view().col(j);
+	}
+
+	VectorView<T> row(size_t i)
+	{
+		return view().row(i);
+	}
+
+	VectorView<const T> row(size_t i) const
+	{
+		return view().row(i);
+	}
+
+	MatrixView<T> block(size_t i, size_t j, size_t rows, size_t cols)
+	{
+		return view().block(i, j, rows, cols);
+	}
+
+	MatrixView<const T> block(size_t i, size_t j, size_t rows, size_t cols) const
+	{
+		return view().block(i, j, rows, cols);
+	}
+
+	// read only streams, Functional::block_stream(m.view(), ...) etc. give
+	// writable views
+	auto col_stream() const
+	{
+		return Functional::col_stream(view());
+	}
+
+	auto row_stream() const
+	{
+		return Functional::row_stream(view());
+	}
+
+	auto block_stream(size_t rows, size_t cols) const
+	{
+		return Functional::block_stream(view(), rows, cols);
+	}
+
+	auto diagonal_block_stream(size_t size) const
+	{
+		return Functional::diagonal_block_stream(view(), size);
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const Matrix<T>& m)
+	{
+		os << "[";
+		for (size_t i = 0; i < m.num_rows; ++i)
+		{
+			os << (i ? "\n [" : "[");
+			for (size_t j = 0; j < m.num_cols; ++j)
+				os << m(i, j) << " ";
+			os << "]";
+		}
+		os << "]";
+		return os;
+	}
+
+	resource_ptr<T> matrix;
+	size_t num_rows;
+	size_t num_cols;
+};
+
+}
+#endif // MATRIX_HPP__
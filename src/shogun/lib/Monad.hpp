@@ -44,11 +44,13 @@ struct Monad : public Functor<A>
 {
 	virtual ~Monad() {};
 
+	// join :: Monad m => m (m a) -> m a
 	template <class B>
 	Monad<B> join(const Monad<Monad<B>>&) const;
 
-	template <class B>
-	Monad<B> bind(const std::function<Monad<B>(A)>&) const;
+	// (>>=) :: Monad m => m a -> (a -> m b) -> m b
+	template <class Mapper>
+	map_result_t<Mapper,A> bind(const Mapper&) const;
 };
 
 }
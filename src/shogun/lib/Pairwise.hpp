@@ -0,0 +1,159 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PAIRWISE_HPP__
+#define PAIRWISE_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <shogun/lib/Matrix.hpp>
+#include <shogun/lib/ThreadPool.hpp>
+#include <shogun/lib/Vector.hpp>
+
+namespace shogun
+{
+
+template <class Kernel, class A, class B>
+using pairwise_result_t = typename std::decay<
+	decltype(std::declval<const Kernel&>()(std::declval<const A&>(), std::declval<const B&>()))>::type;
+
+// tiles are tall column strips: the lhs elements of a tile, which are read
+// once for every column, stay resident in a core's private cache, and the
+// kernel runs over long contiguous runs of a column. the columns per tile
+// bound how much of the output a tile writes, which matters for mirroring.
+inline size_t pairwise_tile_rows(size_t bytes_lhs)
+{
+	const size_t lhs_bytes = 1 << 16;
+	return std::max<size_t>(std::min<size_t>(lhs_bytes / std::max<size_t>(bytes_lhs, 1), 1024), 16);
+}
+
+const size_t pairwise_tile_cols = 64;
+
+// out(i, j) = kernel(lhs[i], rhs[j]) for the m x n column major out, with
+// the tiles spread over the pool. symmetric mode assumes lhs == rhs and a
+// symmetric kernel, only evaluates the upper triangle and mirrors every tile
+// while it is still in cache.
+template <class A, class B, class Kernel, class R>
+void pairwise(const A* lhs, size_t m, const B* rhs, size_t n, const Kernel& kernel, R* out,
+	bool symmetric, ThreadPool& pool)
+{
+	const auto tile_rows = pairwise_tile_rows(sizeof(A));
+	const auto tile_cols = pairwise_tile_cols;
+	std::vector<std::pair<size_t,size_t>> tiles;
+	for (size_t col_begin = 0; col_begin < n; col_begin += tile_cols)
+		for (size_t row_begin = 0; row_begin < (symmetric ? std::min(col_begin + tile_cols, m) : m);
+			row_begin += tile_rows)
+			tiles.emplace_back(row_begin, col_begin);
+
+	pool.parallel_for(0, tiles.size(), 1,
+		[lhs, m, rhs, n, &kernel, out, symmetric, tile_rows, tile_cols, &tiles](size_t begin, size_t end)
+		{
+			for (size_t t = begin; t < end; ++t)
+			{
+				const auto row_begin = tiles[t].first;
+				const auto row_end = std::min(row_begin + tile_rows, m);
+				const auto col_begin = tiles[t].second;
+				const auto col_end = std::min(col_begin + tile_cols, n);
+				for (size_t j = col_begin; j < col_end; ++j)
+				{
+					const auto& b = rhs[j];
+					auto column = out + j * m;
+					const auto last = symmetric ? std::min(row_end, j + 1) : row_end;
+					for (size_t i = row_begin; i < last; ++i)
+						column[i] = kernel(lhs[i], b);
+				}
+				if (!symmetric)
+					continue;
+				// reads from the tile just computed, writes whole runs of columns
+				for (size_t i = row_begin; i < row_end; ++i)
+					for (size_t j = std::max(col_begin, i + 1); j < col_end; ++j)
+						out[j + i * m] = out[i + j * m];
+			}
+		});
+}
+
+namespace Functional
+{
+
+// the lhs.vlen x rhs.vlen matrix of kernel(lhs[i], rhs[j]), e.g. a kernel
+// or distance matrix, computed tile by tile on the pool
+template <class A, class B, class Kernel>
+Matrix<pairwise_result_t<Kernel,A,B>> pairwise(const Vector<A>& lhs, const Vector<B>& rhs,
+	const Kernel& kernel, ThreadPool& pool = ThreadPool::global())
+{
+	Matrix<pairwise_result_t<Kernel,A,B>> result(lhs.vlen, rhs.vlen, Uninitialized());
+	shogun::pairwise(lhs.vec.get(), lhs.vlen, rhs.vec.get(), rhs.vlen, kernel,
+		result.matrix.get(), false, pool);
+	return result;
+}
+
+// the same into existing storage of the right shape
+template <class A, class B, class Kernel, class R>
+void pairwise_into(const Vector<A>& lhs, const Vector<B>& rhs, const Kernel& kernel,
+	Matrix<R>& result, ThreadPool& pool = ThreadPool::global())
+{
+	if (result.num_rows != lhs.vlen || result.num_cols != rhs.vlen)
+		throw std::invalid_argument("pairwise_into() requires a lhs.vlen x rhs.vlen matrix");
+	shogun::pairwise(lhs.vec.get(), lhs.vlen, rhs.vec.get(), rhs.vlen, kernel,
+		result.matrix.get(), false, pool);
+}
+
+// pairwise(x, x, kernel) for a symmetric kernel, with about half the kernel
+// evaluations
+template <class A, class Kernel>
+Matrix<pairwise_result_t<Kernel,A,A>> pairwise_symmetric(const Vector<A>& x, const Kernel& kernel,
+	ThreadPool& pool = ThreadPool::global())
+{
+	Matrix<pairwise_result_t<Kernel,A,A>> result(x.vlen, x.vlen, Uninitialized());
+	shogun::pairwise(x.vec.get(), x.vlen, x.vec.get(), x.vlen, kernel,
+		result.matrix.get(), true, pool);
+	return result;
+}
+
+template <class A, class Kernel, class R>
+void pairwise_symmetric_into(const Vector<A>& x, const Kernel& kernel, Matrix<R>& result,
+	ThreadPool& pool = ThreadPool::global())
+{
+	if (result.num_rows != x.vlen || result.num_cols != x.vlen)
+		throw std::invalid_argument("pairwise_symmetric_into() requires a x.vlen x x.vlen matrix");
+	shogun::pairwise(x.vec.get(), x.vlen, x.vec.get(), x.vlen, kernel,
+		result.matrix.get(), true, pool);
+}
+
+}
+
+}
+#endif // PAIRWISE_HPP__
@@ -0,0 +1,459 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PARSE_HPP__
+#define PARSE_HPP__
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <shogun/lib/Matrix.hpp>
+#include <shogun/lib/Stream.hpp>
+#include <shogun/lib/ThreadPool.hpp>
+#include <shogun/lib/Vector.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace shogun
+{
+
+// numbers in text, e.g. a csv file mapped with MappedVector<char>. the text
+// is [p, end) without a terminating zero. the parsers advance p past the
+// number and return false if there is none, or it is out of range.
+namespace parsing
+{
+
+inline bool is_digit(char c)
+{
+	return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// whitespace within a line
+inline bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// memchr() is vectorized already
+inline const char* find(const char* p, const char* end, char c)
+{
+	if (p == end)
+		return end;
+	auto found = static_cast<const char*>(std::memchr(p, c, end - p));
+	return found ? found : end;
+}
+
+// the number of bytes equal to c, which has no library call. compares 16
+// bytes at a time into bytewise counters, which are summed up before they
+// can overflow.
+inline size_t count(const char* p, const char* end, char c)
+{
+	size_t total = 0;
+#ifdef __SSE2__
+	const __m128i needle = _mm_set1_epi8(c);
+	const __m128i zero = _mm_setzero_si128();
+	while (end - p >= 16)
+	{
+		__m128i counts = zero;
+		for (int i = 0; i < 255 && end - p >= 16; ++i, p += 16)
+		{
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(bytes, needle));
+		}
+		const __m128i sums = _mm_sad_epu8(counts, zero);
+		total += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+	}
+#endif
+	for (; p < end; ++p)
+		total += *p == c;
+	return total;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SHOGUN_HAVE_SWAR_DIGITS 1
+
+// whether the 8 bytes at p are all digits, which are loaded into chunk
+inline bool eight_digits(const char* p, uint64_t& chunk)
+{
+	std::memcpy(&chunk, p, sizeof(chunk));
+	return ((chunk & 0xF0F0F0F0F0F0F0F0) |
+		(((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+// the value of 8 digits with three multiplications instead of eight
+inline uint32_t eight_digits_value(uint64_t chunk)
+{
+	const uint64_t mask = 0x000000FF000000FF;
+	const uint64_t mul1 = 100 + (1000000ULL << 32);
+	const uint64_t mul2 = 1 + (10000ULL << 32);
+	chunk -= 0x3030303030303030;
+	chunk = chunk * 10 + (chunk >> 8);
+	return static_cast<uint32_t>((((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32);
+}
+#endif
+
+// appends the digits at q to mantissa while it has at most 19, which cannot
+// overflow. the digits that do not fit are skipped, truncated tells whether
+// any of them was not a zero.
+inline void read_digits(const char*& q, const char* end, uint64_t& mantissa, int& digits, bool& truncated)
+{
+#ifdef SHOGUN_HAVE_SWAR_DIGITS
+	uint64_t chunk;
+	while (digits <= 11 && end - q >= 8 && eight_digits(q, chunk))
+	{
+		mantissa = mantissa * 100000000 + eight_digits_value(chunk);
+		digits += 8;
+		q += 8;
+	}
+#endif
+	for (; q < end && is_digit(*q); ++q)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*q - '0');
+			++digits;
+		}
+		else
+			truncated |= *q != '0';
+	}
+}
+
+// strtod() for what the fast path does not handle, like long mantissas,
+// large exponents, inf and nan. it needs a terminated copy of the token.
+inline bool parse_slow(const char*& p, const char* end, double& value)
+{
+	const char* q = p;
+	while (q < end && (is_digit(*q) || std::isalpha(static_cast<unsigned char>(*q)) ||
+		*q == '+' || *q == '-' || *q == '.'))
+		++q;
+	const std::string token(p, q);
+	char* stop;
+	value = std::strtod(token.c_str(), &stop);
+	if (stop == token.c_str())
+		return false;
+	p += stop - token.c_str();
+	return true;
+}
+
+// decimal notation like 12, -0.5 or 1.5e-3. a mantissa of up to 2^53 and a
+// power of ten of up to 22 are both exact doubles, so one multiplication or
+// division rounds correctly. everything else goes to strtod().
+inline bool parse(const char*& p, const char* end, double& value)
+{
+	static const double powers[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* q = p;
+	bool negative = false;
+	if (q < end && (*q == '-' || *q == '+'))
+		negative = *q++ == '-';
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	bool truncated = false;
+	const char* integer = q;
+	read_digits(q, end, mantissa, digits, truncated);
+	// skipped integer digits still count
+	int exponent = static_cast<int>(q - integer) - digits;
+	bool any_digits = q != integer;
+	if (q < end && *q == '.')
+	{
+		const char* fraction = ++q;
+		const int integer_digits = digits;
+		read_digits(q, end, mantissa, digits, truncated);
+		exponent -= digits - integer_digits;
+		any_digits |= q != fraction;
+	}
+	if (!any_digits)
+		return parse_slow(p, end, value);
+
+	if (q < end && (*q == 'e' || *q == 'E'))
+	{
+		const char* e = q + 1;
+		bool negative_exponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negative_exponent = *e++ == '-';
+		if (e == end || !is_digit(*e))
+			return false;
+		int written = 0;
+		for (; e < end && is_digit(*e); ++e)
+			if (written < 100000)
+				written = written * 10 + (*e - '0');
+		exponent += negative_exponent ? -written : written;
+		q = e;
+	}
+
+	if (truncated || mantissa > (uint64_t(1) << 53) || exponent < -22 || exponent > 22)
+		return parse_slow(p, end, value);
+	const double m = static_cast<double>(mantissa);
+	value = exponent < 0 ? m / powers[-exponent] : m * powers[exponent];
+	if (negative)
+		value = -value;
+	p = q;
+	return true;
+}
+
+inline bool parse(const char*& p, const char* end, float& value)
+{
+	double parsed;
+	if (!parse(p, end, parsed))
+		return false;
+	value = static_cast<float>(parsed);
+	return true;
+}
+
+// optional sign and decimal digits
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, bool>::type
+parse(const char*& p, const char* end, T& value)
+{
+	const char* q = p;
+	bool negative = false;
+	if (q < end && (*q == '-' || *q == '+'))
+		negative = *q++ == '-';
+	if (q == end || !is_digit(*q) || (negative && !std::is_signed<T>::value))
+		return false;
+	while (q < end && *q == '0')
+		++q;
+
+	// 19 digits always fit, a 20th may not
+	const char* digits = q;
+	uint64_t magnitude = 0;
+	for (; q < end && is_digit(*q) && q - digits < 19; ++q)
+		magnitude = magnitude * 10 + (*q - '0');
+	if (q < end && is_digit(*q))
+	{
+		const unsigned last = *q++ - '0';
+		if (magnitude > (std::numeric_limits<uint64_t>::max() - last) / 10 || (q < end && is_digit(*q)))
+			return false;
+		magnitude = magnitude * 10 + last;
+	}
+	const uint64_t limit = static_cast<uint64_t>(std::numeric_limits<T>::max()) + negative;
+	if (magnitude > limit)
+		return false;
+
+	if (negative && magnitude)
+		value = static_cast<T>(-static_cast<int64_t>(magnitude - 1) - 1);
+	else
+		value = static_cast<T>(magnitude);
+	p = q;
+	return true;
+}
+
+// parses the fields of the line [p, end) into out[0], out[stride], ... and
+// returns their number, or npos if one is malformed. a line with more than
+// max fields gives max + 1. a blank delimiter allows any run of blanks.
+template <class T>
+size_t parse_line(const char* p, const char* end, char delimiter, T* out, size_t stride, size_t max)
+{
+	const auto npos = std::numeric_limits<size_t>::max();
+	const bool blank_delimited = is_blank(delimiter);
+	size_t fields = 0;
+	while (true)
+	{
+		while (p < end && is_blank(*p))
+			++p;
+		if (p == end)
+			// nothing after a delimiter is an empty field
+			return blank_delimited || !fields ? fields : npos;
+		if (fields == max)
+			return max + 1;
+		T value;
+		if (!parse(p, end, value))
+			return npos;
+		if (out)
+			out[fields * stride] = value;
+		++fields;
+
+		if (p == end)
+			return fields;
+		if (blank_delimited)
+		{
+			if (!is_blank(*p))
+				return npos;
+			continue;
+		}
+		while (p < end && is_blank(*p))
+			++p;
+		if (p == end)
+			return fields;
+		if (*p++ != delimiter)
+			return npos;
+	}
+}
+
+}
+
+// a lazy stream of the numbers in text, which are separated by the delimiter,
+// blanks or line breaks. it shares the text, which can be a MappedVector<char>
+// of a file that does not fit into memory.
+template <class T>
+struct NumberSource
+{
+	using value_type = T;
+
+	NumberSource(const Vector<char>& _text, char _delimiter)
+	: text(_text), position(text.vec.get()), delimiter(_delimiter)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		return pull_batch(1, std::forward<Sink>(sink));
+	}
+
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		const char* end = text.vec.get() + text.vlen;
+		size_t pulled = 0;
+		for (; pulled < max; ++pulled)
+		{
+			while (position < end && is_separator(*position))
+				++position;
+			if (position == end)
+				break;
+			T value;
+			if (!parsing::parse(position, end, value) || (position < end && !is_separator(*position)))
+				throw std::invalid_argument("malformed number at offset " +
+					std::to_string(position - text.vec.get()));
+			sink(static_cast<const T&>(value));
+		}
+		return pulled;
+	}
+
+	bool is_separator(char c) const
+	{
+		return c == delimiter || c == '\n' || parsing::is_blank(c);
+	}
+
+	const Vector<char> text;
+	const char* position;
+	char delimiter;
+};
+
+template <class T>
+struct is_batched<NumberSource<T>> : std::true_type
+{
+};
+
+namespace Functional
+{
+
+template <class T>
+Stream<NumberSource<T>> parse_numbers(const Vector<char>& text, char delimiter = ',')
+{
+	return Stream<NumberSource<T>>(NumberSource<T>(text, delimiter));
+}
+
+// a csv table of numbers into a matrix with one row per line, so that the
+// columns are contiguous. the delimiter may be a blank for whitespace
+// separated text. a header line can be skipped with text.slice(). the text
+// is split into chunks of whole lines, which are parsed in parallel after
+// counting their lines gives the rows they go to.
+template <class T>
+Matrix<T> parse_table(const Vector<char>& text, char delimiter = ',', ThreadPool& pool = ThreadPool::global())
+{
+	const char* begin = text.vec.get();
+	const char* end = begin + text.vlen;
+	if (begin == end)
+		return Matrix<T>();
+
+	const auto npos = std::numeric_limits<size_t>::max();
+	const auto num_cols = parsing::parse_line<T>(begin, parsing::find(begin, end, '\n'), delimiter,
+		nullptr, 0, npos - 1);
+	if (!num_cols || num_cols == npos)
+		throw std::invalid_argument("line 1 has no fields or a malformed one");
+
+	const size_t chunk_bytes = 1 << 20;
+	std::vector<const char*> bounds{begin};
+	while (bounds.back() != end)
+	{
+		const char* chunk = bounds.back();
+		const char* last = static_cast<size_t>(end - chunk) > chunk_bytes
+			? parsing::find(chunk + chunk_bytes, end, '\n') : end;
+		bounds.push_back(last == end ? end : last + 1);
+	}
+	const auto num_chunks = bounds.size() - 1;
+
+	// the last line may not end with a line break
+	std::vector<size_t> first_row(num_chunks + 1, 0);
+	pool.parallel_for(0, num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end)
+	{
+		for (auto k = chunk_begin; k < chunk_end; ++k)
+			first_row[k + 1] = parsing::count(bounds[k], bounds[k + 1], '\n');
+	});
+	if (end[-1] != '\n')
+		++first_row[num_chunks];
+	std::partial_sum(first_row.begin(), first_row.end(), first_row.begin());
+
+	const auto num_rows = first_row[num_chunks];
+	Matrix<T> table(num_rows, num_cols, Uninitialized());
+	T* data = table.view().data;
+	pool.parallel_for(0, num_chunks, 1, [&](size_t chunk_begin, size_t chunk_end)
+	{
+		for (auto k = chunk_begin; k < chunk_end; ++k)
+		{
+			auto row = first_row[k];
+			for (const char* line = bounds[k]; line < bounds[k + 1]; ++row)
+			{
+				const char* line_end = parsing::find(line, bounds[k + 1], '\n');
+				const auto fields = parsing::parse_line(line, line_end, delimiter, data + row, num_rows, num_cols);
+				if (fields != num_cols)
+					throw std::invalid_argument("line " + std::to_string(row + 1) +
+						(fields == npos ? " has a malformed field" : " does not have " +
+						std::to_string(num_cols) + " fields"));
+				line = line_end == bounds[k + 1] ? line_end : line_end + 1;
+			}
+		}
+	});
+	return table;
+}
+
+}
+
+}
+#endif // PARSE_HPP__
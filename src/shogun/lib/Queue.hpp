@@ -0,0 +1,211 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QUEUE_HPP__
+#define QUEUE_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <shogun/lib/Slot.hpp>
+
+namespace shogun
+{
+
+// a snapshot of the counters of a SpscQueue. occupancy is the number of
+// elements already waiting when another one is pushed, so a queue whose
+// mean occupancy stays close to its capacity is too small for a bursty
+// producer, and one which is hardly ever more than empty is larger than
+// it needs to be.
+struct QueueStats
+{
+	size_t capacity;
+	size_t pushes;
+	// pushes which found the queue full and had to be retried
+	size_t full;
+	// pops which found the queue empty and had to be retried
+	size_t empty;
+	size_t max_occupancy;
+	size_t total_occupancy;
+
+	double mean_occupancy() const
+	{
+		return pushes ? static_cast<double>(total_occupancy) / pushes : 0;
+	}
+};
+
+// waiting for the other side of a queue. a few rounds of spinning cover
+// the common case of a short stall, after that the thread gives up its time
+// slice, which also keeps a single core from spinning against itself.
+struct Backoff
+{
+	Backoff() : rounds(0)
+	{
+	}
+
+	void wait()
+	{
+		if (++rounds < 16)
+		{
+			for (size_t i = 0; i < rounds; ++i)
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+		}
+		else
+			std::this_thread::yield();
+	}
+
+	size_t rounds;
+};
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. The capacity is rounded up to a power of two. Both indices only
+// ever grow, each is written by one side only and read by the other with
+// acquire semantics, and each side keeps a cached copy of the other index
+// so that it only touches the shared cache line when the cached one says
+// the queue is full, or empty.
+template <class T>
+struct SpscQueue
+{
+	explicit SpscQueue(size_t capacity)
+	: slots(round_up(capacity)), mask(slots.size() - 1),
+	  head(0), cached_tail(0), tail(0), cached_head(0)
+	{
+		pushes = full = empty = max_occupancy = total_occupancy = 0;
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	size_t capacity() const
+	{
+		return slots.size();
+	}
+
+	// producer side, false if the queue is full
+	template <class... Args>
+	bool try_push(Args&&... args)
+	{
+		auto t = tail.load(std::memory_order_relaxed);
+		if (t - cached_head == slots.size())
+		{
+			cached_head = head.load(std::memory_order_acquire);
+			if (t - cached_head == slots.size())
+			{
+				count(full);
+				return false;
+			}
+		}
+		slots[t & mask].emplace(std::forward<Args>(args)...);
+		tail.store(t + 1, std::memory_order_release);
+		// cached_head is only refreshed when the queue looks full, so it
+		// would count every pop since then as still waiting
+		cached_head = head.load(std::memory_order_acquire);
+		auto occupancy = t - cached_head;
+		count(pushes);
+		total_occupancy.store(total_occupancy.load(std::memory_order_relaxed) + occupancy,
+			std::memory_order_relaxed);
+		if (occupancy > max_occupancy.load(std::memory_order_relaxed))
+			max_occupancy.store(occupancy, std::memory_order_relaxed);
+		return true;
+	}
+
+	// consumer side, hands the oldest element to sink and false if the
+	// queue is empty
+	template <class Sink>
+	bool try_pop(Sink&& sink)
+	{
+		auto h = head.load(std::memory_order_relaxed);
+		if (h == cached_tail)
+		{
+			cached_tail = tail.load(std::memory_order_acquire);
+			if (h == cached_tail)
+			{
+				count(empty);
+				return false;
+			}
+		}
+		auto& slot = slots[h & mask];
+		sink(std::move(*slot));
+		slot.reset();
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	// may be called from any thread, the counters are updated without
+	// synchronization between them
+	QueueStats stats() const
+	{
+		return QueueStats{capacity(), pushes.load(), full.load(), empty.load(),
+			max_occupancy.load(), total_occupancy.load()};
+	}
+
+private:
+	static size_t round_up(size_t n)
+	{
+		size_t power = 1;
+		while (power < n)
+			power *= 2;
+		return power;
+	}
+
+	// every counter has a single writer
+	static void count(std::atomic<size_t>& counter)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	std::vector<Slot<T>> slots;
+	const size_t mask;
+
+	// the two sides are kept on separate cache lines
+	char before_consumer[64];
+
+	// consumer
+	std::atomic<size_t> head;
+	size_t cached_tail;
+	std::atomic<size_t> empty;
+
+	char before_producer[64];
+
+	// producer
+	std::atomic<size_t> tail;
+	size_t cached_head;
+	std::atomic<size_t> pushes;
+	std::atomic<size_t> full;
+	std::atomic<size_t> max_occupancy;
+	std::atomic<size_t> total_occupancy;
+};
+
+}
+#endif // QUEUE_HPP__
@@ -0,0 +1,191 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RECORDS_HPP__
+#define RECORDS_HPP__
+
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <tuple>
+#include <utility>
+#include <shogun/lib/Allocator.hpp>
+#include <shogun/lib/Collection.hpp>
+#include <shogun/lib/Collectors.hpp>
+#include <shogun/lib/Vector.hpp>
+
+namespace shogun
+{
+
+// vlen records of fields Ts..., stored structure of arrays: each field is a
+// Vector of its own. a pipeline over one field only ever touches that
+// column, and arithmetic columns get the vectorized kernels of Vector.
+// pipelines whose mapper returns a tuple (or pair) scatter into the columns
+// with yield_records() or Collectors::to_records().
+template <class... Ts>
+struct RecordVector
+{
+	using record_type = std::tuple<Ts...>;
+
+	template <size_t I>
+	using field_type = typename std::tuple_element<I,record_type>::type;
+
+	RecordVector() : vlen(0)
+	{
+	}
+
+	// fields are value-initialized, i.e. zero for arithmetic types
+	RecordVector(size_t size, MemoryResource* resource = default_resource())
+	: columns(Vector<Ts>(size, resource)...), vlen(size)
+	{
+	}
+
+	// default-initialized fields, i.e. indeterminate for arithmetic types
+	RecordVector(size_t size, Uninitialized, MemoryResource* resource = default_resource())
+	: columns(Vector<Ts>(size, Uninitialized(), resource)...), vlen(size)
+	{
+	}
+
+	// the columns are shared until one of the copies is written to
+	RecordVector(const RecordVector&) = default;
+	RecordVector& operator=(const RecordVector&) = default;
+
+	RecordVector(RecordVector&& other) : columns(std::move(other.columns)), vlen(other.vlen)
+	{
+		other.vlen = 0;
+	}
+
+	RecordVector& operator=(RecordVector&& other)
+	{
+		columns = std::move(other.columns);
+		vlen = other.vlen;
+		other.vlen = 0;
+		return *this;
+	}
+
+	size_t size() const
+	{
+		return vlen;
+	}
+
+	template <size_t I>
+	Vector<field_type<I>>& column()
+	{
+		return std::get<I>(columns);
+	}
+
+	template <size_t I>
+	const Vector<field_type<I>>& column() const
+	{
+		return std::get<I>(columns);
+	}
+
+	// a pipeline over the I-th field
+	template <size_t I>
+	Eval<Vector,field_type<I>,field_type<I>,Identity<field_type<I>>> field() const
+	{
+		return Functional::evaluate(column<I>());
+	}
+
+	// gathers the i-th record
+	record_type operator[](size_t i) const
+	{
+		return get(i, std::index_sequence_for<Ts...>());
+	}
+
+	// scatters a tuple like record into the i-th position of every column.
+	// every call checks the columns for copy-on-write, loops use data()
+	template <class Record>
+	void set(size_t i, const Record& record)
+	{
+		set(data(), i, record);
+	}
+
+	// the elements of every column, which are copied first if they are
+	// shared, so that bulk writes can go through the pointers
+	std::tuple<Ts*...> data()
+	{
+		return data(std::index_sequence_for<Ts...>());
+	}
+
+	// scatters a record into the i-th position of columns from data()
+	template <class Record>
+	static void set(const std::tuple<Ts*...>& data, size_t i, const Record& record)
+	{
+		set(data, i, record, std::index_sequence_for<Ts...>());
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const RecordVector& records)
+	{
+		os << "[";
+		for (size_t i = 0; i < records.vlen; ++i)
+		{
+			os << "(";
+			records.print(os, i, std::index_sequence_for<Ts...>());
+			os << ") ";
+		}
+		os << "]";
+		return os;
+	}
+
+	std::tuple<Vector<Ts>...> columns;
+	size_t vlen;
+
+private:
+	template <size_t... I>
+	record_type get(size_t i, std::index_sequence<I...>) const
+	{
+		return record_type(std::get<I>(columns).vec[i]...);
+	}
+
+	template <size_t... I>
+	std::tuple<Ts*...> data(std::index_sequence<I...>)
+	{
+		return std::tuple<Ts*...>(std::get<I>(columns).vec.get()...);
+	}
+
+	template <class Record, size_t... I>
+	static void set(const std::tuple<Ts*...>& data, size_t i, const Record& record, std::index_sequence<I...>)
+	{
+		using std::get;
+		(void)std::initializer_list<int>{(std::get<I>(data)[i] = get<I>(record), 0)...};
+	}
+
+	template <size_t... I>
+	void print(std::ostream& os, size_t i, std::index_sequence<I...>) const
+	{
+		(void)std::initializer_list<int>{(os << (I ? " " : "") << std::get<I>(columns).vec[i], 0)...};
+	}
+};
+
+}
+#endif // RECORDS_HPP__
@@ -0,0 +1,400 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REDUCE_HPP__
+#define REDUCE_HPP__
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <shogun/lib/Mapper.hpp>
+#include <shogun/lib/Math.hpp>
+#include <shogun/lib/ThreadPool.hpp>
+
+namespace shogun
+{
+
+struct Plus
+{
+	template <class T>
+	T operator()(const T& a, const T& b) const
+	{
+		return a + b;
+	}
+};
+
+struct Minimum
+{
+	template <class T>
+	T operator()(const T& a, const T& b) const
+	{
+		return b < a ? b : a;
+	}
+};
+
+struct Maximum
+{
+	template <class T>
+	T operator()(const T& a, const T& b) const
+	{
+		return a < b ? b : a;
+	}
+};
+
+template <class T>
+T lowest()
+{
+	return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity()
+		: std::numeric_limits<T>::lowest();
+}
+
+template <class T>
+T highest()
+{
+	return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+		: std::numeric_limits<T>::max();
+}
+
+// Folds values into a fixed number of independent accumulators, one per
+// lane, so that consecutive additions do not wait for each other and the
+// compiler can keep the lanes in SIMD registers. Like std::reduce this
+// requires op to be associative and commutative.
+template <class Op, class R>
+struct LaneAccumulator
+{
+	static constexpr size_t lanes = 8;
+
+	LaneAccumulator(const Op& _op, const R& init) : op(_op), result(init), seeded(0)
+	{
+	}
+
+	// folds value(i) for i in [0, n)
+	template <class Values>
+	void add(size_t n, const Values& value)
+	{
+		size_t i = 0;
+		for (; seeded < lanes && i < n; ++i)
+			acc[seeded++] = value(i);
+		for (; i + lanes <= n; i += lanes)
+			for (size_t l = 0; l < lanes; ++l)
+				acc[l] = op(acc[l], value(i + l));
+		for (; i < n; ++i)
+			result = op(result, value(i));
+	}
+
+	R finish() const
+	{
+		R r = result;
+		for (size_t l = 0; l < seeded; ++l)
+			r = op(r, acc[l]);
+		return r;
+	}
+
+	Op op;
+	R result;
+	R acc[lanes];
+	size_t seeded;
+};
+
+// elements per block when a lowerable mapper first runs through the batch
+// kernels into a buffer which stays in L1 and is folded from there
+constexpr size_t reduce_block_size = 512;
+
+template <class Mapper, class A, class Op, class R>
+R reduce(const Mapper& mapper, const A* src, size_t n, const Op& op, R init, std::false_type)
+{
+	LaneAccumulator<Op,R> acc(op, init);
+	acc.add(n, [src, &mapper](size_t i) { return mapper(src[i]); });
+	return acc.finish();
+}
+
+// whether map_blocks can buffer the mapped values, i.e. they run through the
+// batch kernels, or are cheap to copy and a block of them fits in L1
+template <class Mapper, class A, class B = map_result_t<Mapper,A>>
+struct is_stageable : std::integral_constant<bool, math::is_lowerable<Mapper,A,B>::value
+	|| (std::is_trivially_copyable<B>::value && sizeof(B) <= 2 * sizeof(double))>
+{
+};
+
+// maps [0, n) block by block into an L1-sized buffer, through the batch
+// kernels where possible, and hands every block to consume(values, m)
+template <class Mapper, class A, class Consumer>
+void map_blocks(const Mapper& mapper, const A* src, size_t n, const Consumer& consume)
+{
+	static_assert(is_stageable<Mapper,A>::value, "mapped values have to be small and trivially copyable");
+	map_result_t<Mapper,A> block[reduce_block_size];
+	for (size_t i = 0; i < n; i += reduce_block_size)
+	{
+		auto m = std::min(reduce_block_size, n - i);
+		math::transform(mapper, src + i, block, m);
+		consume(static_cast<const map_result_t<Mapper,A>*>(block), m);
+	}
+}
+
+template <class Mapper, class A, class Op, class R>
+R reduce(const Mapper& mapper, const A* src, size_t n, const Op& op, R init, std::true_type)
+{
+	LaneAccumulator<Op,R> acc(op, init);
+	map_blocks(mapper, src, n, [&acc](const double* block, size_t m)
+	{
+		acc.add(m, [block](size_t j) { return block[j]; });
+	});
+	return acc.finish();
+}
+
+// op-fold of mapper(src[i]) for i in [0, n) into init. the mapped values are
+// never stored, apart from one L1-sized block for SIMD lowered mappers.
+template <class Mapper, class A, class Op, class R>
+R reduce(const Mapper& mapper, const A* src, size_t n, const Op& op, R init)
+{
+	return reduce(mapper, src, n, op, init, math::is_lowerable<Mapper,A,map_result_t<Mapper,A>>());
+}
+
+template <class Mapper, class A, class B>
+B dot(const Mapper& mapper, const A* src, const B* other, size_t n, std::false_type)
+{
+	LaneAccumulator<Plus,B> acc(Plus(), B(0));
+	acc.add(n, [src, other, &mapper](size_t i) { return mapper(src[i]) * other[i]; });
+	return acc.finish();
+}
+
+template <class Mapper, class A>
+double dot(const Mapper& mapper, const A* src, const double* other, size_t n, std::true_type)
+{
+	LaneAccumulator<Plus,double> acc(Plus(), 0.0);
+	map_blocks(mapper, src, n, [&acc, &other](const double* block, size_t m)
+	{
+		auto rhs = other;
+		acc.add(m, [block, rhs](size_t j) { return block[j] * rhs[j]; });
+		other += m;
+	});
+	return acc.finish();
+}
+
+// sum of mapper(src[i]) * other[i] for i in [0, n)
+template <class Mapper, class A, class B>
+B dot(const Mapper& mapper, const A* src, const B* other, size_t n)
+{
+	return dot(mapper, src, other, n, math::is_lowerable<Mapper,A,B>());
+}
+
+// How sum() adds up floating point values.
+// unordered: lane accumulators, partial sums of parallel chunks are added in
+//     whatever order the chunks finish. fastest, but the last bits of the
+//     result may differ between runs and thread counts.
+// pairwise: the input is cut into leaves of summation_leaf_size elements,
+//     independent of the number of threads, and the leaf sums are added up
+//     along a fixed binary tree. bit-identical results at any thread count,
+//     and an error growing with log(n) rather than n.
+// compensated: Neumaier summation within the same leaves, whose sums and
+//     compensations are merged along the same fixed tree. also
+//     deterministic and accurate to a few ulp of the exact sum.
+enum class Summation
+{
+	unordered,
+	pairwise,
+	compensated
+};
+
+constexpr size_t summation_leaf_size = 1024;
+
+// Neumaier's variant of Kahan summation, which also stays exact when an
+// addend is larger in magnitude than the running sum
+template <class T>
+struct CompensatedSum
+{
+	CompensatedSum() : sum(0), compensation(0)
+	{
+	}
+
+	void add(T x)
+	{
+		T t = sum + x;
+		compensation += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+		sum = t;
+	}
+
+	void merge(const CompensatedSum& other)
+	{
+		add(other.sum);
+		compensation += other.compensation;
+	}
+
+	T result() const
+	{
+		return sum + compensation;
+	}
+
+	T sum;
+	T compensation;
+};
+
+template <class Mapper, class A>
+CompensatedSum<map_result_t<Mapper,A>> compensated_sum(const Mapper& mapper, const A* src, size_t n)
+{
+	using B = map_result_t<Mapper,A>;
+	// the lanes are kept as separate arrays of sums and compensations, with a
+	// select instead of a branch, so that the loop vectorizes
+	constexpr size_t lanes = 8;
+	B sums[lanes] = {};
+	B compensations[lanes] = {};
+	map_blocks(mapper, src, n, [&sums, &compensations](const B* block, size_t m)
+	{
+		size_t j = 0;
+		for (; j + lanes <= m; j += lanes)
+		{
+			for (size_t l = 0; l < lanes; ++l)
+			{
+				B x = block[j + l];
+				B t = sums[l] + x;
+				B big = std::abs(sums[l]) >= std::abs(x) ? sums[l] : x;
+				B small = std::abs(sums[l]) >= std::abs(x) ? x : sums[l];
+				compensations[l] += (big - t) + small;
+				sums[l] = t;
+			}
+		}
+		for (; j < m; ++j)
+		{
+			CompensatedSum<B> tail;
+			tail.sum = sums[0];
+			tail.compensation = compensations[0];
+			tail.add(block[j]);
+			sums[0] = tail.sum;
+			compensations[0] = tail.compensation;
+		}
+	});
+	CompensatedSum<B> total;
+	for (size_t l = 0; l < lanes; ++l)
+	{
+		CompensatedSum<B> lane;
+		lane.sum = sums[l];
+		lane.compensation = compensations[l];
+		total.merge(lane);
+	}
+	return total;
+}
+
+template <class T>
+T pairwise_combine(const T* partials, size_t n)
+{
+	if (n == 0)
+		return T(0);
+	if (n == 1)
+		return partials[0];
+	return pairwise_combine(partials, n / 2) + pairwise_combine(partials + n / 2, n - n / 2);
+}
+
+// the same tree for compensated leaf sums, merging the compensations along
+template <class T>
+CompensatedSum<T> pairwise_combine(const CompensatedSum<T>* partials, size_t n)
+{
+	if (n == 0)
+		return CompensatedSum<T>();
+	if (n == 1)
+		return partials[0];
+	auto total = pairwise_combine(partials, n / 2);
+	total.merge(pairwise_combine(partials + n / 2, n - n / 2));
+	return total;
+}
+
+// runs leaf(i) for i in [0, num_leaves), on the pool if there is one
+template <class Leaf>
+void for_each_leaf(size_t num_leaves, ThreadPool* pool, const Leaf& leaf)
+{
+	auto leaves = [&leaf](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+			leaf(i);
+	};
+	if (pool)
+		pool->parallel_for(0, num_leaves, 16, leaves);
+	else
+		leaves(0, num_leaves);
+}
+
+template <class Mapper, class A>
+map_result_t<Mapper,A> sum(const Mapper& mapper, const A* src, size_t n, Summation mode,
+	ThreadPool* pool = nullptr)
+{
+	using B = map_result_t<Mapper,A>;
+	const auto num_leaves = (n + summation_leaf_size - 1) / summation_leaf_size;
+	auto leaf_size = [n](size_t leaf)
+	{
+		return std::min(summation_leaf_size, n - leaf * summation_leaf_size);
+	};
+	switch (mode)
+	{
+	case Summation::unordered:
+	{
+		if (!pool)
+			return reduce(mapper, src, n, Plus(), B(0));
+		B total(0);
+		std::mutex mutex;
+		pool->parallel_for(0, n, cache_chunk_size(sizeof(A)),
+			[src, &mapper, &total, &mutex](size_t begin, size_t end)
+			{
+				auto partial = reduce(mapper, src + begin, end - begin, Plus(), B(0));
+				std::lock_guard<std::mutex> lock(mutex);
+				total += partial;
+			});
+		return total;
+	}
+	case Summation::pairwise:
+	{
+		std::vector<B> partials(num_leaves);
+		for_each_leaf(num_leaves, pool, [&](size_t leaf)
+		{
+			auto begin = leaf * summation_leaf_size;
+			partials[leaf] = reduce(mapper, src + begin, leaf_size(leaf), Plus(), B(0));
+		});
+		return pairwise_combine(partials.data(), num_leaves);
+	}
+	case Summation::compensated:
+	default:
+	{
+		std::vector<CompensatedSum<B>> partials(num_leaves);
+		for_each_leaf(num_leaves, pool, [&](size_t leaf)
+		{
+			auto begin = leaf * summation_leaf_size;
+			partials[leaf] = compensated_sum(mapper, src + begin, leaf_size(leaf));
+		});
+		return pairwise_combine(partials.data(), num_leaves).result();
+	}
+	}
+}
+
+}
+#endif // REDUCE_HPP__
@@ -0,0 +1,106 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SLOT_HPP__
+#define SLOT_HPP__
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace shogun
+{
+
+// holds at most one T without requiring T to be default constructible or
+// assignable, which closures are not. also serves as the result of terminals
+// which may not find anything.
+template <class T>
+struct Slot
+{
+	Slot() : engaged(false) {}
+
+	Slot(const Slot& other) : engaged(false)
+	{
+		if (other.engaged)
+			emplace(*other);
+	}
+
+	Slot(Slot&& other) : engaged(false)
+	{
+		if (other.engaged)
+			emplace(std::move(*other));
+	}
+
+	Slot& operator=(const Slot&) = delete;
+
+	~Slot()
+	{
+		reset();
+	}
+
+	template <class... Args>
+	void emplace(Args&&... args)
+	{
+		reset();
+		new (&storage) T(std::forward<Args>(args)...);
+		engaged = true;
+	}
+
+	void reset()
+	{
+		if (engaged)
+			(**this).~T();
+		engaged = false;
+	}
+
+	explicit operator bool() const
+	{
+		return engaged;
+	}
+
+	T& operator*()
+	{
+		return *reinterpret_cast<T*>(&storage);
+	}
+
+	const T& operator*() const
+	{
+		return *reinterpret_cast<const T*>(&storage);
+	}
+
+private:
+	typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	bool engaged;
+};
+
+}
+#endif // SLOT_HPP__
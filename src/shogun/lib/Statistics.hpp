@@ -0,0 +1,460 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STATISTICS_HPP__
+#define STATISTICS_HPP__
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <shogun/lib/Collectors.hpp>
+
+namespace shogun
+{
+
+// running count, mean and sum of squared deviations of a sequence, updated
+// one element at a time (Welford) and merged pairwise (Chan et al.), so that
+// partial states of different threads or blocks can be combined in O(1)
+template <class R = double>
+struct Moments
+{
+	Moments() : count(0), mean(0), m2(0)
+	{
+	}
+
+	void add(R x)
+	{
+		++count;
+		R delta = x - mean;
+		mean += delta / count;
+		m2 += delta * (x - mean);
+	}
+
+	// adds a block of values at once, with two passes over the block followed
+	// by a merge. much cheaper than one division per element, and the block
+	// stays in cache between the passes
+	void add(const R* values, size_t n)
+	{
+		if (n == 0)
+			return;
+		R sum = 0;
+		for (size_t i = 0; i < n; ++i)
+			sum += values[i];
+		Moments block;
+		block.count = n;
+		block.mean = sum / n;
+		for (size_t i = 0; i < n; ++i)
+			block.m2 += (values[i] - block.mean) * (values[i] - block.mean);
+		merge(block);
+	}
+
+	void merge(const Moments& other)
+	{
+		if (other.count == 0)
+			return;
+		if (count == 0)
+		{
+			*this = other;
+			return;
+		}
+		size_t n = count + other.count;
+		R delta = other.mean - mean;
+		R weight = static_cast<R>(other.count) / n;
+		mean += delta * weight;
+		m2 += other.m2 + delta * delta * count * weight;
+		count = n;
+	}
+
+	// ddof = 1 gives the unbiased sample variance, ddof = 0 the population one
+	R variance(size_t ddof = 1) const
+	{
+		if (count <= ddof)
+			return std::numeric_limits<R>::quiet_NaN();
+		return m2 / (count - ddof);
+	}
+
+	R stddev(size_t ddof = 1) const
+	{
+		return std::sqrt(variance(ddof));
+	}
+
+	size_t count;
+	R mean;
+	R m2;
+};
+
+// the same for pairs (x, y), which additionally tracks the co-moment
+template <class R = double>
+struct CoMoments
+{
+	CoMoments() : count(0), mean_x(0), mean_y(0), m2_x(0), m2_y(0), c(0)
+	{
+	}
+
+	void add(R x, R y)
+	{
+		++count;
+		R delta_x = x - mean_x;
+		R delta_y = y - mean_y;
+		mean_x += delta_x / count;
+		mean_y += delta_y / count;
+		m2_x += delta_x * (x - mean_x);
+		m2_y += delta_y * (y - mean_y);
+		c += delta_x * (y - mean_y);
+	}
+
+	void merge(const CoMoments& other)
+	{
+		if (other.count == 0)
+			return;
+		if (count == 0)
+		{
+			*this = other;
+			return;
+		}
+		size_t n = count + other.count;
+		R delta_x = other.mean_x - mean_x;
+		R delta_y = other.mean_y - mean_y;
+		R weight = static_cast<R>(other.count) / n;
+		mean_x += delta_x * weight;
+		mean_y += delta_y * weight;
+		m2_x += other.m2_x + delta_x * delta_x * count * weight;
+		m2_y += other.m2_y + delta_y * delta_y * count * weight;
+		c += other.c + delta_x * delta_y * count * weight;
+		count = n;
+	}
+
+	R covariance(size_t ddof = 1) const
+	{
+		if (count <= ddof)
+			return std::numeric_limits<R>::quiet_NaN();
+		return c / (count - ddof);
+	}
+
+	R correlation() const
+	{
+		return c / std::sqrt(m2_x * m2_y);
+	}
+
+	Moments<R> x() const
+	{
+		Moments<R> result;
+		result.count = count;
+		result.mean = mean_x;
+		result.m2 = m2_x;
+		return result;
+	}
+
+	Moments<R> y() const
+	{
+		Moments<R> result;
+		result.count = count;
+		result.mean = mean_y;
+		result.m2 = m2_y;
+		return result;
+	}
+
+	size_t count;
+	R mean_x;
+	R mean_y;
+	R m2_x;
+	R m2_y;
+	R c;
+};
+
+namespace Collectors
+{
+
+struct Counting
+{
+	using combinable = std::true_type;
+
+	template <class T>
+	size_t supply() const
+	{
+		return 0;
+	}
+
+	template <class T>
+	void accumulate(size_t& count, const T&) const
+	{
+		++count;
+	}
+
+	void combine(size_t& count, size_t&& other) const
+	{
+		count += other;
+	}
+
+	size_t finish(size_t&& count) const
+	{
+		return count;
+	}
+};
+
+// Moments plus a small buffer of pending values, which are folded in a block
+// at a time
+template <class R>
+struct BufferedMoments
+{
+	static constexpr size_t capacity = 256;
+
+	BufferedMoments() : pending(0)
+	{
+	}
+
+	void add(R x)
+	{
+		buffer[pending++] = x;
+		if (pending == capacity)
+			flush();
+	}
+
+	void flush()
+	{
+		moments.add(buffer, pending);
+		pending = 0;
+	}
+
+	Moments<R> moments;
+	R buffer[capacity];
+	size_t pending;
+};
+
+// collects the Moments of the elements, Finisher turns them into the result
+template <class R, class Finisher>
+struct MomentsOf
+{
+	using combinable = std::true_type;
+
+	MomentsOf(const Finisher& _finisher) : finisher(_finisher)
+	{
+	}
+
+	template <class T>
+	BufferedMoments<R> supply() const
+	{
+		return BufferedMoments<R>();
+	}
+
+	template <class T>
+	void accumulate(BufferedMoments<R>& moments, const T& value) const
+	{
+		moments.add(static_cast<R>(value));
+	}
+
+	void combine(BufferedMoments<R>& moments, BufferedMoments<R>&& other) const
+	{
+		moments.flush();
+		other.flush();
+		moments.moments.merge(other.moments);
+	}
+
+	auto finish(BufferedMoments<R>&& moments) const
+	{
+		moments.flush();
+		return finisher(moments.moments);
+	}
+
+	Finisher finisher;
+};
+
+// collects the CoMoments of pair like elements, i.e. anything std::get<0>
+// and std::get<1> work with
+template <class R, class Finisher>
+struct CoMomentsOf
+{
+	using combinable = std::true_type;
+
+	CoMomentsOf(const Finisher& _finisher) : finisher(_finisher)
+	{
+	}
+
+	template <class T>
+	CoMoments<R> supply() const
+	{
+		return CoMoments<R>();
+	}
+
+	template <class T>
+	void accumulate(CoMoments<R>& moments, const T& value) const
+	{
+		using std::get;
+		moments.add(static_cast<R>(get<0>(value)), static_cast<R>(get<1>(value)));
+	}
+
+	void combine(CoMoments<R>& moments, CoMoments<R>&& other) const
+	{
+		moments.merge(other);
+	}
+
+	auto finish(CoMoments<R>&& moments) const
+	{
+		return finisher(moments);
+	}
+
+	Finisher finisher;
+};
+
+// Moments per key for pair like elements (key, value) with keys in
+// [0, num_keys), e.g. one statistic per kernel. a dense alternative to
+// grouping_by(key, moments()) for small integral keys
+template <class R>
+struct IndexedMoments
+{
+	using combinable = std::true_type;
+
+	IndexedMoments(size_t _num_keys) : num_keys(_num_keys)
+	{
+	}
+
+	template <class T>
+	std::vector<Moments<R>> supply() const
+	{
+		return std::vector<Moments<R>>(num_keys);
+	}
+
+	template <class T>
+	void accumulate(std::vector<Moments<R>>& moments, const T& value) const
+	{
+		using std::get;
+		size_t key = get<0>(value);
+		if (key >= moments.size())
+			throw std::out_of_range("key out of range");
+		moments[key].add(static_cast<R>(get<1>(value)));
+	}
+
+	void combine(std::vector<Moments<R>>& moments, std::vector<Moments<R>>&& other) const
+	{
+		for (size_t i = 0; i < moments.size(); ++i)
+			moments[i].merge(other[i]);
+	}
+
+	std::vector<Moments<R>> finish(std::vector<Moments<R>>&& moments) const
+	{
+		return std::move(moments);
+	}
+
+	size_t num_keys;
+};
+
+template <class R>
+struct Identically
+{
+	const R& operator()(const R& r) const
+	{
+		return r;
+	}
+};
+
+template <class R>
+struct MeanOf
+{
+	R operator()(const Moments<R>& moments) const
+	{
+		return moments.count ? moments.mean : std::numeric_limits<R>::quiet_NaN();
+	}
+};
+
+template <class R>
+struct VarianceOf
+{
+	R operator()(const Moments<R>& moments) const
+	{
+		return moments.variance(ddof);
+	}
+
+	size_t ddof;
+};
+
+template <class R>
+struct CovarianceOf
+{
+	R operator()(const CoMoments<R>& moments) const
+	{
+		return moments.covariance(ddof);
+	}
+
+	size_t ddof;
+};
+
+inline Counting counting()
+{
+	return Counting();
+}
+
+// count, mean and variance in one pass
+template <class R = double>
+MomentsOf<R,Identically<Moments<R>>> moments()
+{
+	return MomentsOf<R,Identically<Moments<R>>>(Identically<Moments<R>>());
+}
+
+template <class R = double>
+MomentsOf<R,MeanOf<R>> averaging()
+{
+	return MomentsOf<R,MeanOf<R>>(MeanOf<R>());
+}
+
+template <class R = double>
+MomentsOf<R,VarianceOf<R>> variance(size_t ddof = 1)
+{
+	return MomentsOf<R,VarianceOf<R>>(VarianceOf<R>{ddof});
+}
+
+template <class R = double>
+CoMomentsOf<R,Identically<CoMoments<R>>> co_moments()
+{
+	return CoMomentsOf<R,Identically<CoMoments<R>>>(Identically<CoMoments<R>>());
+}
+
+template <class R = double>
+CoMomentsOf<R,CovarianceOf<R>> covariance(size_t ddof = 1)
+{
+	return CoMomentsOf<R,CovarianceOf<R>>(CovarianceOf<R>{ddof});
+}
+
+template <class R = double>
+IndexedMoments<R> indexed_moments(size_t num_keys)
+{
+	return IndexedMoments<R>(num_keys);
+}
+
+}
+
+}
+#endif // STATISTICS_HPP__
@@ -0,0 +1,1160 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef STREAM_HPP__
+#define STREAM_HPP__
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <shogun/lib/Mapper.hpp>
+#include <shogun/lib/Queue.hpp>
+#include <shogun/lib/Collectors.hpp>
+#include <shogun/lib/Reduce.hpp>
+#include <shogun/lib/Slot.hpp>
+#include <shogun/lib/Vector.hpp>
+#include <shogun/lib/View.hpp>
+#include <shogun/lib/WorkStealing.hpp>
+
+namespace shogun
+{
+
+// A Stream is a lazy, pull-based sequence. Every stage is a plain struct
+// which holds its upstream by value, so a chain of stages is one concrete
+// type whose pull() the compiler can inline end to end. Elements are only
+// produced when a terminal operation asks for them, which lets unbounded
+// sources finish as soon as e.g. take(n) is satisfied, in constant memory.
+//
+// The stage protocol is a single member function
+//
+//     template <class Sink> bool pull(Sink&& sink);
+//
+// which hands at most one element to sink and returns false once the stage
+// is exhausted. Elements are passed to the sink rather than returned so that
+// stages never need default constructible values.
+//
+// Stages over a bounded source are also splittable,
+//
+//     size_t size() const;                    number of upstream elements
+//     Stage slice(size_t begin, size_t end) const;
+//
+// where slice() is the same pipeline over a part of the source only, which
+// is what the parallel terminals hand out to the WorkStealingPool.
+//
+// Most stages can also hand over a whole batch at a time,
+//
+//     template <class Sink> bool pull_batch(size_t max, Sink&& sink);
+//
+// which calls sink for up to max elements, possibly none of them, in one
+// counted loop and returns false once the stage is exhausted. The sinks of
+// a chain inline into that loop, so e.g. a range mapped and summed compiles
+// down to a loop the compiler can vectorize, without any buffer in between.
+// Terminals drain sources like that whenever every stage supports it.
+// filter() and flat_map() do not. A filter puts a conditional store to the
+// accumulator of the terminal into the loop, which GCC neither vectorizes
+// nor if-converts, and then the batch only adds a second loop around it.
+// The inner streams of a flat_map are typically short, and their batches
+// cost more than they save.
+template <class Source>
+struct Stream;
+
+// elements per pull_batch() of the terminals. it bounds how far a stage may
+// run ahead of a take(n) further down, which asks for no more than it needs.
+constexpr size_t stream_batch_size = 256;
+
+template <class Source>
+struct is_batched : std::false_type
+{
+};
+
+template <class Source, class Sink>
+bool pull_batch_from(Source& source, size_t max, Sink&& sink, std::true_type)
+{
+	return source.pull_batch(max, std::forward<Sink>(sink));
+}
+
+template <class Source, class Sink>
+bool pull_batch_from(Source& source, size_t, Sink&& sink, std::false_type)
+{
+	return source.pull(std::forward<Sink>(sink));
+}
+
+// a batch of source, or a single element if it does not support batches
+template <class Source, class Sink>
+bool pull_batch_from(Source& source, size_t max, Sink&& sink)
+{
+	return pull_batch_from(source, max, std::forward<Sink>(sink), is_batched<Source>());
+}
+
+template <class T>
+struct is_stream : std::false_type
+{
+};
+
+template <class Source>
+struct is_stream<Stream<Source>> : std::true_type
+{
+};
+
+// the number of elements of [begin, end) in steps of step > 0, like numpy's
+// arange() the smallest count with begin + count * step >= end
+template <class T>
+size_t range_count(T begin, T end, T step, std::true_type)
+{
+	if (!(begin < end))
+		return 0;
+	// in unsigned arithmetic end - begin cannot overflow
+	const auto span = static_cast<uint64_t>(end) - static_cast<uint64_t>(begin);
+	return static_cast<size_t>((span - 1) / static_cast<uint64_t>(step) + 1);
+}
+
+template <class T>
+size_t range_count(T begin, T end, T step, std::false_type)
+{
+	if (!(begin < end))
+		return 0;
+	return static_cast<size_t>(std::ceil((end - begin) / step));
+}
+
+// [begin, end) in steps of step > 0, or [begin, inf) when unbounded. the
+// elements are counted rather than compared with end, and each is computed
+// from its index, so they never overflow past end, fractional steps do not
+// add up rounding errors and pull(), size() and slice() always agree.
+template <class T>
+struct RangeSource
+{
+	using value_type = T;
+
+	RangeSource(T _begin, T end, T _step, bool _bounded)
+	: begin(_begin), step(_step), index(0),
+	  count(_bounded ? range_count(_begin, end, _step, std::is_integral<T>()) : std::numeric_limits<size_t>::max()),
+	  bounded(_bounded)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		if (index == count)
+			return false;
+		sink(static_cast<const T&>(at(index++)));
+		return true;
+	}
+
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		if (index == count)
+			return false;
+		// the loop runs on copies of the state. a sink which stores through
+		// e.g. a long& could alias the members, and reloading them after
+		// every store would keep the loop from vectorizing.
+		const auto first = index;
+		const auto last = first + std::min(max, count - first);
+		index = last;
+		batch(begin, step, first, last, sink, std::is_integral<T>());
+		return true;
+	}
+
+	size_t size() const
+	{
+		if (!bounded)
+			throw std::logic_error("an unbounded range cannot be split");
+		return count - index;
+	}
+
+	RangeSource slice(size_t begin, size_t end) const
+	{
+		RangeSource part(*this);
+		part.index = index + begin;
+		part.count = index + end;
+		return part;
+	}
+
+	// two's complement wraps around instead of overflowing, which only
+	// unbounded ranges get to
+	T at(size_t i) const
+	{
+		return at(begin, step, i, std::is_integral<T>());
+	}
+
+	static T at(T begin, T step, size_t i, std::true_type)
+	{
+		return static_cast<T>(static_cast<uint64_t>(begin) + static_cast<uint64_t>(i) * static_cast<uint64_t>(step));
+	}
+
+	static T at(T begin, T step, size_t i, std::false_type)
+	{
+		return begin + static_cast<T>(i) * step;
+	}
+
+	template <class Sink>
+	static void batch(T begin, T step, size_t first, size_t last, Sink& sink, std::true_type)
+	{
+		for (size_t i = first; i < last; ++i)
+			sink(static_cast<const T&>(at(begin, step, i, std::true_type())));
+	}
+
+	// counts in T as well, which saves converting i on every element, as
+	// long as T represents every index exactly
+	template <class Sink>
+	static void batch(T begin, T step, size_t first, size_t last, Sink& sink, std::false_type)
+	{
+		const auto digits = std::numeric_limits<T>::digits;
+		if (digits < 64 && last > (uint64_t(1) << (digits < 64 ? digits : 0)))
+		{
+			for (size_t i = first; i < last; ++i)
+				sink(static_cast<const T&>(at(begin, step, i, std::false_type())));
+			return;
+		}
+		T k = static_cast<T>(first);
+		for (size_t i = first; i < last; ++i, k += 1)
+			sink(static_cast<const T&>(begin + k * step));
+	}
+
+	T begin;
+	T step;
+	size_t index;
+	size_t count;
+	bool bounded;
+};
+
+template <class T>
+struct VectorSource
+{
+	using value_type = T;
+
+	explicit VectorSource(const Vector<T>& _source) : source(_source), index(0), end(source.vlen)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		if (index == end)
+			return false;
+		sink(static_cast<const T&>(source.vec[index++]));
+		return true;
+	}
+
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		if (index == end)
+			return false;
+		const auto n = std::min(max, end - index);
+		const T* values = source.vec.get() + index;
+		for (size_t i = 0; i < n; ++i)
+			sink(values[i]);
+		index += n;
+		return true;
+	}
+
+	size_t size() const
+	{
+		return end - index;
+	}
+
+	VectorSource slice(size_t begin, size_t end) const
+	{
+		VectorSource part(source);
+		part.index = index + begin;
+		part.end = index + end;
+		return part;
+	}
+
+	// shares the elements, copies of the stream do not copy them
+	const Vector<T> source;
+	size_t index;
+	size_t end;
+};
+
+template <class Source, class Mapper>
+struct MapStage
+{
+	using value_type = map_result_t<Mapper,typename Source::value_type>;
+
+	MapStage(const Source& _source, const Mapper& _mapper) : source(_source), mapper(_mapper)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		return source.pull([this, &sink](const typename Source::value_type& a)
+		{
+			sink(mapper(a));
+		});
+	}
+
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		return pull_batch_from(source, max, [this, &sink](const typename Source::value_type& a)
+		{
+			sink(mapper(a));
+		});
+	}
+
+	size_t size() const
+	{
+		return source.size();
+	}
+
+	MapStage slice(size_t begin, size_t end) const
+	{
+		return MapStage(source.slice(begin, end), mapper);
+	}
+
+	Source source;
+	Mapper mapper;
+};
+
+template <class Source, class Predicate>
+struct FilterStage
+{
+	using value_type = typename Source::value_type;
+
+	FilterStage(const Source& _source, const Predicate& _predicate)
+	: source(_source), predicate(_predicate)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		bool found = false;
+		while (!found)
+		{
+			auto pulled = source.pull([this, &sink, &found](const value_type& a)
+			{
+				if (predicate(a))
+				{
+					sink(a);
+					found = true;
+				}
+			});
+			if (!pulled)
+				return false;
+		}
+		return true;
+	}
+
+	size_t size() const
+	{
+		return source.size();
+	}
+
+	FilterStage slice(size_t begin, size_t end) const
+	{
+		return FilterStage(source.slice(begin, end), predicate);
+	}
+
+	Source source;
+	Predicate predicate;
+};
+
+template <class Source>
+struct TakeStage
+{
+	using value_type = typename Source::value_type;
+
+	TakeStage(const Source& _source, size_t _remaining) : source(_source), remaining(_remaining)
+	{
+	}
+
+	// never touches upstream once the quota is met
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		if (remaining == 0 || !source.pull(sink))
+			return false;
+		--remaining;
+		return true;
+	}
+
+	// upstream is asked for no more than the quota
+	template <class Sink>
+	bool pull_batch(size_t max, Sink&& sink)
+	{
+		if (remaining == 0)
+			return false;
+		size_t taken = 0;
+		auto pulled = pull_batch_from(source, std::min(max, remaining), [&sink, &taken](const value_type& a)
+		{
+			sink(a);
+			++taken;
+		});
+		remaining -= taken;
+		return pulled;
+	}
+
+	Source source;
+	size_t remaining;
+};
+
+// passes elements on until the first one which does not satisfy predicate,
+// and never touches upstream after that
+template <class Source, class Predicate>
+struct TakeWhileStage
+{
+	using value_type = typename Source::value_type;
+
+	TakeWhileStage(const Source& _source, const Predicate& _predicate)
+	: source(_source), predicate(_predicate), done(false)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		if (done)
+			return false;
+		bool passed = false;
+		auto pulled = source.pull([this, &sink, &passed](const value_type& a)
+		{
+			if (predicate(a))
+			{
+				sink(a);
+				passed = true;
+			}
+		});
+		done = !pulled || !passed;
+		return !done;
+	}
+
+	Source source;
+	Predicate predicate;
+	bool done;
+};
+
+// concatenates the streams produced by upstream, holding at most one inner
+// stream at a time
+template <class Source>
+struct FlattenStage
+{
+	using inner_type = typename Source::value_type;
+	using value_type = typename inner_type::value_type;
+
+	static_assert(is_stream<inner_type>::value, "flat_map() requires a stream of streams");
+
+	explicit FlattenStage(const Source& _source) : source(_source)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		while (true)
+		{
+			if (inner && (*inner).pull(sink))
+				return true;
+			inner.reset();
+			auto pulled = source.pull([this](const inner_type& next)
+			{
+				inner.emplace(next);
+			});
+			if (!pulled)
+				return false;
+		}
+	}
+
+	// splits the outer stream, the inner ones are split by the parallel
+	// terminals themselves
+	size_t size() const
+	{
+		return source.size();
+	}
+
+	FlattenStage slice(size_t begin, size_t end) const
+	{
+		return FlattenStage(source.slice(begin, end));
+	}
+
+	Source source;
+	Slot<inner_type> inner;
+};
+
+// a stage boundary: upstream runs on a thread of its own, which starts with
+// the first pull, and hands its elements over through a bounded SpscQueue.
+// the producer waits while the queue is full, so it is never more than
+// capacity elements ahead. every copy runs a producer and a queue of its
+// own, since a single producer queue cannot feed two consumers. a stage
+// whose producer started cannot be copied.
+template <class Source>
+struct AsyncStage
+{
+	using value_type = typename Source::value_type;
+
+	struct Channel
+	{
+		Channel(const Source& _source, size_t capacity)
+		: source(_source), queue(capacity), done(false), cancelled(false)
+		{
+		}
+
+		// a consumer which stops early, e.g. after take(n), cancels the
+		// producer, which drops the element it is waiting to push
+		~Channel()
+		{
+			cancelled.store(true);
+			if (producer.joinable())
+				producer.join();
+		}
+
+		void start()
+		{
+			producer = std::thread([this]()
+			{
+				try
+				{
+					// temporaries, e.g. from map(), are moved into the queue. a
+					// push which fails leaves its argument untouched.
+					while (!cancelled.load(std::memory_order_relaxed) && pull_batch_from(source, stream_batch_size, [this](auto&& v)
+					{
+						Backoff backoff;
+						while (!queue.try_push(std::forward<decltype(v)>(v))
+							&& !cancelled.load(std::memory_order_relaxed))
+							backoff.wait();
+					}));
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+				done.store(true, std::memory_order_release);
+			});
+		}
+
+		Source source;
+		SpscQueue<value_type> queue;
+		std::atomic<bool> done;
+		std::atomic<bool> cancelled;
+		std::exception_ptr error;
+		std::thread producer;
+	};
+
+	AsyncStage(const Source& _source, size_t _capacity) : source(_source), capacity(_capacity)
+	{
+	}
+
+	AsyncStage(const AsyncStage& other) : source(other.source), capacity(other.capacity)
+	{
+		if (other.channel)
+			throw std::logic_error("an async() stage cannot be copied once it was pulled from");
+	}
+
+	AsyncStage(AsyncStage&&) = default;
+	AsyncStage& operator=(const AsyncStage&) = delete;
+	AsyncStage& operator=(AsyncStage&&) = default;
+
+	// an exception thrown upstream is rethrown here once the elements
+	// produced before it are consumed
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		if (!channel)
+		{
+			channel.reset(new Channel(source, capacity));
+			channel->start();
+		}
+		Backoff backoff;
+		while (!channel->queue.try_pop(sink))
+		{
+			if (channel->done.load(std::memory_order_acquire))
+			{
+				if (channel->queue.try_pop(sink))
+					return true;
+				if (channel->error)
+					std::rethrow_exception(std::exchange(channel->error, nullptr));
+				return false;
+			}
+			backoff.wait();
+		}
+		return true;
+	}
+
+	QueueStats stats() const
+	{
+		if (!channel)
+			return QueueStats{capacity, 0, 0, 0, 0, 0};
+		return channel->queue.stats();
+	}
+
+	// where the producer starts from, it pulls from a copy of its own
+	Source source;
+	size_t capacity;
+	std::unique_ptr<Channel> channel;
+};
+
+template <class Source>
+struct is_splittable : std::false_type
+{
+};
+
+template <class T>
+struct is_splittable<RangeSource<T>> : std::true_type
+{
+};
+
+template <class T>
+struct is_splittable<VectorSource<T>> : std::true_type
+{
+};
+
+template <class Source, class Mapper>
+struct is_splittable<MapStage<Source,Mapper>> : is_splittable<Source>
+{
+};
+
+template <class Source, class Predicate>
+struct is_splittable<FilterStage<Source,Predicate>> : is_splittable<Source>
+{
+};
+
+template <class Source>
+struct is_splittable<FlattenStage<Source>> : is_splittable<Source>
+{
+};
+
+template <class T>
+struct is_batched<RangeSource<T>> : std::true_type
+{
+};
+
+template <class T>
+struct is_batched<VectorSource<T>> : std::true_type
+{
+};
+
+template <class Source, class Mapper>
+struct is_batched<MapStage<Source,Mapper>> : std::true_type
+{
+};
+
+template <class Source>
+struct is_batched<TakeStage<Source>> : std::true_type
+{
+};
+
+// whether the elements of Source are only valid until its next pull, like
+// the blocks of a BlockReader. stages which pass them on as they are keep
+// that, a map() to anything else ends it.
+template <class Source>
+struct is_transient : std::false_type
+{
+};
+
+template <class Source, class Mapper>
+struct is_transient<MapStage<Source,Mapper>>
+: std::integral_constant<bool, is_transient<Source>::value
+	&& std::is_same<typename MapStage<Source,Mapper>::value_type, typename Source::value_type>::value>
+{
+};
+
+template <class Source, class Predicate>
+struct is_transient<FilterStage<Source,Predicate>> : is_transient<Source>
+{
+};
+
+template <class Source>
+struct is_transient<TakeStage<Source>> : is_transient<Source>
+{
+};
+
+template <class Source, class Predicate>
+struct is_transient<TakeWhileStage<Source,Predicate>> : is_transient<Source>
+{
+};
+
+// a flat_map whose inner streams can be split as well
+template <class Source>
+struct splits_inner : std::false_type
+{
+};
+
+template <class Source>
+struct splits_inner<FlattenStage<Source>>
+: is_splittable<typename FlattenStage<Source>::inner_type::source_type>
+{
+};
+
+// elements per leaf of a parallel terminal, small enough for the pool to
+// even out leaves of very different cost
+inline size_t parallel_grain(size_t n, const WorkStealingPool& pool)
+{
+	return std::max<size_t>(n / (pool.num_threads() * 8), 1);
+}
+
+template <class Source, class Consumer>
+void for_each_split(const Source& source, const Consumer& consumer, WorkStealingPool& pool);
+
+template <class Source, class Collector>
+auto collect_split(const Source& source, const Collector& collector, WorkStealingPool& pool);
+
+template <class Part, class Consumer>
+void for_each_part(Part& part, const Consumer& consumer, WorkStealingPool&, std::false_type)
+{
+	while (pull_batch_from(part, stream_batch_size, consumer));
+}
+
+// the inner streams of a flat_map are split again while there are threads
+// without work, so that a few expensive inner streams are spread over the
+// pool as well. otherwise they are pulled in place, which is much cheaper.
+template <class Part, class Consumer>
+void for_each_part(Part& part, const Consumer& consumer, WorkStealingPool& pool, std::true_type)
+{
+	using Inner = typename Part::inner_type::source_type;
+	while (part.source.pull([&consumer, &pool](const typename Part::inner_type& inner)
+	{
+		if (pool.starving())
+			for_each_split(inner.source, consumer, pool);
+		else
+		{
+			auto source = inner.source;
+			for_each_part(source, consumer, pool, splits_inner<Inner>());
+		}
+	}));
+}
+
+template <class Source, class Consumer>
+void for_each_split(const Source& source, const Consumer& consumer, WorkStealingPool& pool)
+{
+	const auto n = source.size();
+	pool.parallel_for(0, n, parallel_grain(n, pool), [&source, &consumer, &pool](size_t begin, size_t end)
+	{
+		auto part = source.slice(begin, end);
+		for_each_part(part, consumer, pool, splits_inner<Source>());
+	});
+}
+
+template <class Part, class Container, class Collector>
+void collect_part(Part& part, Container& container, const Collector& collector,
+	WorkStealingPool&, std::false_type)
+{
+	while (pull_batch_from(part, stream_batch_size, [&container, &collector](const typename Part::value_type& v)
+	{
+		collector.accumulate(container, v);
+	}));
+}
+
+template <class Part, class Container, class Collector>
+void collect_part(Part& part, Container& container, const Collector& collector,
+	WorkStealingPool& pool, std::true_type)
+{
+	using Inner = typename Part::inner_type::source_type;
+	while (part.source.pull([&container, &collector, &pool](const typename Part::inner_type& inner)
+	{
+		if (pool.starving())
+			collector.combine(container, collect_split(inner.source, collector, pool));
+		else
+		{
+			auto source = inner.source;
+			collect_part(source, container, collector, pool, splits_inner<Inner>());
+		}
+	}));
+}
+
+// the first element which satisfies predicate, or any such element if any is
+// true. leaves after the one with a match are skipped, those in flight stop
+// at their next element.
+template <class Source, class Predicate>
+Slot<typename Source::value_type> find_split(const Source& source, const Predicate& predicate,
+	bool any, WorkStealingPool& pool)
+{
+	using T = typename Source::value_type;
+	const auto n = source.size();
+	const auto grain = parallel_grain(n, pool);
+	const auto num_leaves = (n + grain - 1) / grain;
+	std::vector<Slot<T>> found(num_leaves);
+	std::atomic<size_t> first(num_leaves);
+	pool.parallel_for(0, num_leaves, 1,
+		[&source, &predicate, any, n, grain, num_leaves, &found, &first](size_t begin, size_t end)
+		{
+			for (size_t leaf = begin; leaf < end; ++leaf)
+			{
+				auto cancelled = [&first, any, leaf, num_leaves]()
+				{
+					auto match = first.load(std::memory_order_relaxed);
+					return any ? match != num_leaves : match < leaf;
+				};
+				auto part = source.slice(leaf * grain, std::min(leaf * grain + grain, n));
+				while (!found[leaf] && !cancelled() && part.pull([&predicate, &found, leaf](const T& v)
+				{
+					if (predicate(v))
+						found[leaf].emplace(v);
+				}));
+				if (found[leaf])
+				{
+					auto match = first.load();
+					while (leaf < match && !first.compare_exchange_weak(match, leaf));
+					return;
+				}
+			}
+		});
+	Slot<T> result;
+	if (first != num_leaves)
+		result.emplace(std::move(*found[first]));
+	return result;
+}
+
+// the leaves are fixed by the size alone and their partial results are
+// combined in order, so the result does not depend on the scheduling
+template <class Source, class Collector>
+auto collect_split(const Source& source, const Collector& collector, WorkStealingPool& pool)
+{
+	using T = typename Source::value_type;
+	using Container = decltype(collector.template supply<T>());
+	const auto n = source.size();
+	const auto grain = parallel_grain(n, pool);
+	std::vector<std::unique_ptr<Container>> partials((n + grain - 1) / grain);
+	pool.parallel_for(0, partials.size(), 1,
+		[&source, &collector, &pool, &partials, n, grain](size_t begin, size_t end)
+		{
+			for (size_t leaf = begin; leaf < end; ++leaf)
+			{
+				auto part = source.slice(leaf * grain, std::min(leaf * grain + grain, n));
+				auto partial = std::make_unique<Container>(collector.template supply<T>());
+				collect_part(part, *partial, collector, pool, splits_inner<Source>());
+				partials[leaf] = std::move(partial);
+			}
+		});
+	auto container = collector.template supply<T>();
+	for (auto& partial : partials)
+		collector.combine(container, std::move(*partial));
+	return container;
+}
+
+template <class Source>
+struct Stream
+{
+	using source_type = Source;
+	using value_type = typename Source::value_type;
+
+	explicit Stream(const Source& _source) : source(_source)
+	{
+	}
+
+	template <class Sink>
+	bool pull(Sink&& sink)
+	{
+		return source.pull(std::forward<Sink>(sink));
+	}
+
+	template <class Mapper>
+	Stream<MapStage<Source,Mapper>> map(const Mapper& mapper) const
+	{
+		return Stream<MapStage<Source,Mapper>>(MapStage<Source,Mapper>(source, mapper));
+	}
+
+	template <class Predicate>
+	Stream<FilterStage<Source,Predicate>> filter(const Predicate& predicate) const
+	{
+		return Stream<FilterStage<Source,Predicate>>(FilterStage<Source,Predicate>(source, predicate));
+	}
+
+	Stream<TakeStage<Source>> take(size_t n) const
+	{
+		return Stream<TakeStage<Source>>(TakeStage<Source>(source, n));
+	}
+
+	// same as take(n)
+	Stream<TakeStage<Source>> limit(size_t n) const
+	{
+		return take(n);
+	}
+
+	template <class Predicate>
+	Stream<TakeWhileStage<Source,Predicate>> take_while(const Predicate& predicate) const
+	{
+		return Stream<TakeWhileStage<Source,Predicate>>(TakeWhileStage<Source,Predicate>(source, predicate));
+	}
+
+	// join :: m (m a) -> m a
+	Stream<FlattenStage<Source>> flat_map() const
+	{
+		return Stream<FlattenStage<Source>>(FlattenStage<Source>(source));
+	}
+
+	// (>>=) :: m a -> (a -> m b) -> m b
+	template <class Mapper>
+	Stream<FlattenStage<MapStage<Source,Mapper>>> flat_map(const Mapper& mapper) const
+	{
+		return map(mapper).flat_map();
+	}
+
+	// everything up to here runs on a thread of its own, ahead of the stages
+	// after it by at most capacity elements, e.g. to produce the next block
+	// while the current one is reduced. the queue counters are available
+	// from stats() of the stage which ran, e.g. source.stats() of the
+	// returned stream, also once a terminal ran. stages added after it hold
+	// a copy of it, which runs a producer of its own.
+	Stream<AsyncStage<Source>> async(size_t capacity = 16) const
+	{
+		static_assert(!is_transient<Source>::value,
+			"async() would hand over elements which the next pull invalidates, map them to copies first");
+		return Stream<AsyncStage<Source>>(AsyncStage<Source>(source, capacity));
+	}
+
+	// terminal, pulls every remaining element through the pipeline
+	template <class Consumer>
+	void for_each(const Consumer& consumer)
+	{
+		while (pull_batch_from(source, stream_batch_size, consumer));
+	}
+
+	// terminal, stops pulling at the first element which satisfies predicate
+	template <class Predicate>
+	Slot<value_type> find_first(const Predicate& predicate)
+	{
+		Slot<value_type> found;
+		while (!found && source.pull([&predicate, &found](const value_type& v)
+		{
+			if (predicate(v))
+				found.emplace(v);
+		}));
+		return found;
+	}
+
+	template <class Predicate>
+	bool any_match(const Predicate& predicate)
+	{
+		return static_cast<bool>(find_first(predicate));
+	}
+
+	template <class Predicate>
+	bool all_match(const Predicate& predicate)
+	{
+		return !any_match(Not<Predicate>{predicate});
+	}
+
+	template <class Predicate>
+	bool none_match(const Predicate& predicate)
+	{
+		return !any_match(predicate);
+	}
+
+	// terminal, op-fold of the remaining elements into init
+	template <class Op, class R>
+	R reduce(const Op& op, R init)
+	{
+		for_each([&op, &init](const value_type& v) { init = op(init, v); });
+		return init;
+	}
+
+	value_type sum()
+	{
+		return reduce(Plus(), value_type(0));
+	}
+
+	// NaN for an empty stream
+	double mean()
+	{
+		size_t count = 0;
+		double mean = 0;
+		for_each([&count, &mean](const value_type& v)
+		{
+			mean += (static_cast<double>(v) - mean) / ++count;
+		});
+		return count ? mean : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	value_type min()
+	{
+		return reduce(Minimum(), highest<value_type>());
+	}
+
+	value_type max()
+	{
+		return reduce(Maximum(), lowest<value_type>());
+	}
+
+	// terminal, folds the remaining elements with a collector
+	template <class Collector>
+	auto collect(const Collector& collector)
+	{
+		auto container = collector.template supply<value_type>();
+		for_each([&container, &collector](const value_type& v)
+		{
+			collector.accumulate(container, v);
+		});
+		return collector.finish(std::move(container));
+	}
+
+	template <class Supplier, class Accumulator>
+	auto collect(const Supplier& supplier, const Accumulator& accumulator)
+	{
+		return collect(Collectors::of(supplier, accumulator));
+	}
+
+	// terminal, for_each on the pool. consumer is called concurrently and in
+	// no particular order
+	template <class Consumer>
+	void for_each_parallel(const Consumer& consumer, WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		static_assert(is_splittable<Source>::value,
+			"parallel terminals require a bounded source and no take()");
+		for_each_split(source, consumer, pool);
+	}
+
+	// terminal, find_first on the pool. gives the same result as find_first()
+	template <class Predicate>
+	Slot<value_type> find_first_parallel(const Predicate& predicate,
+		WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		static_assert(is_splittable<Source>::value,
+			"parallel terminals require a bounded source and no take()");
+		return find_split(source, predicate, false, pool);
+	}
+
+	template <class Predicate>
+	bool any_match_parallel(const Predicate& predicate, WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		static_assert(is_splittable<Source>::value,
+			"parallel terminals require a bounded source and no take()");
+		return static_cast<bool>(find_split(source, predicate, true, pool));
+	}
+
+	template <class Predicate>
+	bool all_match_parallel(const Predicate& predicate, WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		return !any_match_parallel(Not<Predicate>{predicate}, pool);
+	}
+
+	template <class Predicate>
+	bool none_match_parallel(const Predicate& predicate, WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		return !any_match_parallel(predicate, pool);
+	}
+
+	// terminal, collect on the pool. gives the same result as collect()
+	template <class Collector>
+	auto collect_parallel(const Collector& collector, WorkStealingPool& pool = WorkStealingPool::global())
+	{
+		static_assert(is_splittable<Source>::value,
+			"parallel terminals require a bounded source and no take()");
+		static_assert(Collector::combinable::value,
+			"collect_parallel() requires a collector which can combine partial results");
+		return collector.finish(collect_split(source, collector, pool));
+	}
+
+	// terminal, materializes the remaining elements. does not return for an
+	// unbounded stream unless it was limited with take()
+	Vector<value_type> yield()
+	{
+		return collect(Collectors::to_vector<value_type>());
+	}
+
+	// yield() for streams of tuple like records, stored one column per field,
+	// see Records.hpp
+	auto yield_records()
+	{
+		return collect(Collectors::to_records());
+	}
+
+	// the remaining elements, materialized once on first use, see Cached.
+	// Functional::stream(cached.get()) streams over them again.
+	Cached<Vector,value_type> cache() const
+	{
+		return persist(nullptr);
+	}
+
+	Cached<Vector,value_type> persist(MemoryResource* resource) const
+	{
+		auto pipeline = *this;
+		return Cached<Vector,value_type>([pipeline]() mutable { return pipeline.yield(); }, resource);
+	}
+
+	Source source;
+};
+
+namespace Functional
+{
+
+// [begin, end)
+template <class T>
+Stream<RangeSource<T>> range(T begin, T end)
+{
+	return Stream<RangeSource<T>>(RangeSource<T>(begin, end, T(1), true));
+}
+
+// begin, begin + step, ... up to, not including, end. step has to be positive.
+template <class T>
+Stream<RangeSource<T>> range(T begin, T end, T step)
+{
+	if (!(T(0) < step))
+		throw std::invalid_argument("range() requires a positive step");
+	return Stream<RangeSource<T>>(RangeSource<T>(begin, end, step, true));
+}
+
+// [begin, inf)
+template <class T>
+Stream<RangeSource<T>> range(T begin)
+{
+	return Stream<RangeSource<T>>(RangeSource<T>(begin, begin, T(1), false));
+}
+
+// lazy view over the elements of a vector, which it shares rather than copies
+template <class T>
+Stream<VectorSource<T>> stream(const Vector<T>& source)
+{
+	return Stream<VectorSource<T>>(VectorSource<T>(source));
+}
+
+// consecutive views of size elements, the last one may be shorter. the
+// stream shares the storage of source, so it may outlive the Vector passed
+// in, the views only as long as the stream.
+template <class T>
+auto block_stream(const Vector<T>& source, size_t size)
+{
+	if (size == 0)
+		throw std::invalid_argument("block size has to be positive");
+	const auto n = source.vlen;
+	return range<size_t>(0, (n + size - 1) / size).map([source, n, size](size_t k)
+	{
+		return VectorView<const T>(source.vec.get() + k * size, std::min(size, n - k * size));
+	});
+}
+
+}
+
+}
+#endif // STREAM_HPP__
@@ -0,0 +1,111 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef THREAD_POOL_HPP__
+#define THREAD_POOL_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <shogun/lib/WorkStealing.hpp>
+
+namespace shogun
+{
+
+// number of elements per chunk such that a chunk's input and output together
+// stay resident in a core's private cache while it is being mapped
+inline size_t cache_chunk_size(size_t bytes_per_element)
+{
+	const size_t chunk_bytes = 1 << 16;
+	return std::max<size_t>(chunk_bytes / std::max<size_t>(bytes_per_element, 1), 1);
+}
+
+// Chunked parallel loops on the workers of a WorkStealingPool. The global
+// pool runs on the workers of WorkStealingPool::global(), so that mixing
+// e.g. Vector and Stream parallel terminals in one pipeline never puts more
+// threads on the cores than there are. The thread that calls parallel_for()
+// takes part in the work, so a pool without workers simply runs everything
+// inline.
+struct ThreadPool
+{
+	explicit ThreadPool(size_t num_workers)
+	: owned(new WorkStealingPool(num_workers)), scheduler(*owned)
+	{
+	}
+
+	// shares the workers of scheduler
+	explicit ThreadPool(WorkStealingPool& _scheduler) : scheduler(_scheduler)
+	{
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	static ThreadPool& global()
+	{
+		static ThreadPool pool(WorkStealingPool::global());
+		return pool;
+	}
+
+	size_t num_threads() const
+	{
+		return scheduler.num_threads();
+	}
+
+	// runs body(chunk_begin, chunk_end) over [begin, end) split into chunks of
+	// at most chunk_size elements, aligned to begin, and blocks until every
+	// chunk is done. the chunks are stolen as they are in a WorkStealingPool,
+	// so a slow chunk does not hold up the rest.
+	template <class Body>
+	void parallel_for(size_t begin, size_t end, size_t chunk_size, const Body& body)
+	{
+		if (begin >= end)
+			return;
+		chunk_size = std::max<size_t>(chunk_size, 1);
+		const size_t num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+		scheduler.parallel_for(0, num_chunks, 1, [&body, begin, end, chunk_size](size_t first, size_t last)
+		{
+			for (size_t chunk = first; chunk < last; ++chunk)
+			{
+				auto chunk_begin = begin + chunk * chunk_size;
+				body(chunk_begin, std::min(chunk_begin + chunk_size, end));
+			}
+		});
+	}
+
+private:
+	std::unique_ptr<WorkStealingPool> owned;
+	WorkStealingPool& scheduler;
+};
+
+}
+#endif // THREAD_POOL_HPP__
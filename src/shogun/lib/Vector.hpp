@@ -35,33 +35,84 @@
 
 #include <iostream>
 #include <functional>
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <initializer_list>
+#include <stdexcept>
+#include <vector>
+#include <shogun/lib/Allocator.hpp>
 #include <shogun/lib/Collection.hpp>
+#include <shogun/lib/Collectors.hpp>
+#include <shogun/lib/Mapper.hpp>
+#include <shogun/lib/Math.hpp>
+#include <shogun/lib/Reduce.hpp>
+#include <shogun/lib/Slot.hpp>
+#include <shogun/lib/ThreadPool.hpp>
 #include <shogun/lib/Eval.hpp>
+#include <shogun/lib/Cache.hpp>
 
 namespace shogun
 {
 
+// a dense array of Ts. the elements live in a SharedArray: copies and slices
+// share them, and the first write through a copy copies them. only const
+// access is free. non-const vec.get(), vec[i] and begin() check whether the
+// elements are shared every time, and copy them if they are, or if they are
+// a read only mapping, see MappedVector. reads should go through a const
+// reference, and loops which write should take vec.get() once and write
+// through the pointer.
 template <class T>
 struct Vector : public Collection<T>
 {
 	using iterator_type = typename Collection<T>::iterator_type;
 
-	Vector(std::initializer_list<T> list)
-	: vec(std::make_unique<T[]>(list.size())), vlen(list.size())
+	Vector() : vlen(0)
+	{
+	}
+
+	Vector(std::initializer_list<T> list, MemoryResource* resource = default_resource())
+	: vec(allocate_array<T>(list.size(), resource, false), list.size()), vlen(list.size())
 	{
 		std::copy(list.begin(), list.end(), vec.get());
 	}
 
-	Vector(size_t size)
-	: vec(std::make_unique<T[]>(size)), vlen(size)
+	// elements are value-initialized, i.e. zero for arithmetic types
+	Vector(size_t size, MemoryResource* resource = default_resource())
+	: vec(allocate_array<T>(size, resource, true), size), vlen(size)
+	{
+	}
+
+	// default-initialized elements, i.e. indeterminate for arithmetic types
+	Vector(size_t size, Uninitialized, MemoryResource* resource = default_resource())
+	: vec(allocate_array<T>(size, resource, false), size), vlen(size)
+	{
+	}
+
+	// copies share the elements until one of them is written to, see
+	// SharedArray
+	Vector(const Vector& other) : vec(other.vec), vlen(other.vlen)
+	{
+	}
+
+	Vector(Vector&& other) : vec(std::move(other.vec)), vlen(other.vlen)
+	{
+		other.vlen = 0;
+	}
+
+	Vector& operator=(const Vector& other)
 	{
-		std::fill(begin(), end(), static_cast<T>(0));
+		vec = other.vec;
+		vlen = other.vlen;
+		return *this;
 	}
 
-	Vector(const Vector& other) : vec(std::move(vec)), vlen(other.vlen)
+	Vector& operator=(Vector&& other)
 	{
+		vec = std::move(other.vec);
+		vlen = other.vlen;
+		other.vlen = 0;
+		return *this;
 	}
 
 	virtual ~Vector() {}
@@ -76,26 +127,333 @@ struct Vector : public Collection<T>
 		return iterator_type(vec.get() + vlen);
 	}
 
+	// Collection hands out mutable iterators from const collections as well.
+	// they must not be written through, which would bypass copy-on-write.
 	virtual iterator_type begin() const override
 	{
-		return iterator_type(vec.get());
+		return iterator_type(const_cast<T*>(vec.get()));
 	}
 
 	virtual iterator_type end() const override
 	{
-		return iterator_type(vec.get() + vlen);
+		return iterator_type(const_cast<T*>(vec.get() + vlen));
+	}
+
+	// elements [begin, end) without copying them
+	Vector slice(size_t begin, size_t end) const
+	{
+		if (begin > end || end > vlen)
+			throw std::out_of_range("slice() out of range");
+		return Vector(vec.slice(begin, end), end - begin);
 	}
 
 	// fmap :: Functor f => (a -> b) -> f a -> f b
-	template <class B>
-	Vector<B> fmap(const std::function<B(T)>& mapper) const
+	template <class Mapper>
+	Vector<map_result_t<Mapper,T>> fmap(const Mapper& mapper) const
+	{
+		Vector<map_result_t<Mapper,T>> target(vlen, Uninitialized());
+		collect(mapper, Collectors::to_vector(target));
+		return target;
+	}
+
+	// fmap over cache-sized chunks of the vector, mapped concurrently by the
+	// workers of the pool and written straight into the result
+	template <class Mapper>
+	Vector<map_result_t<Mapper,T>> fmap_parallel(const Mapper& mapper,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		Vector<map_result_t<Mapper,T>> target(vlen, Uninitialized());
+		collect_parallel(mapper, Collectors::to_vector(target), pool);
+		return target;
+	}
+
+	// fmap into existing storage, which is only reallocated if its size does
+	// not match. repeated calls with same-sized inputs do not allocate.
+	template <class Mapper, class B>
+	void fmap_into(const Mapper& mapper, Vector<B>& target) const
+	{
+		if (target.vlen != vlen)
+			target = Vector<B>(vlen, Uninitialized());
+		collect(mapper, Collectors::to_vector(target));
+	}
+
+	template <class Mapper, class B>
+	void fmap_parallel_into(const Mapper& mapper, Vector<B>& target,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		if (target.vlen != vlen)
+			target = Vector<B>(vlen, Uninitialized());
+		collect_parallel(mapper, Collectors::to_vector(target), pool);
+	}
+
+	template <class Mapper, class Collector>
+	auto collect(const Mapper& mapper, const Collector& collector) const
+	{
+		auto container = collector.template supply<map_result_t<Mapper,T>>();
+		auto src = vec.get();
+		for (size_t i = 0; i < vlen; ++i)
+			collector.accumulate(container, mapper(src[i]));
+		return collector.finish(std::move(container));
+	}
+
+	// fmap for mappers returning tuple like records, which are scattered
+	// field by field into the columns of a RecordVector, see Records.hpp
+	template <class Mapper>
+	records_of_t<map_result_t<Mapper,T>> fmap_records(const Mapper& mapper) const
 	{
-		Vector<B> target(vlen);
-		std::transform(begin(), end(), target.begin(), mapper);
+		records_of_t<map_result_t<Mapper,T>> target(vlen, Uninitialized());
+		collect(mapper, Collectors::to_records(target));
 		return target;
 	}
 
-	friend std::ostream& operator<<(std::ostream& os, Vector<T>& v)
+	template <class Mapper>
+	records_of_t<map_result_t<Mapper,T>> fmap_records_parallel(const Mapper& mapper,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		using Records = records_of_t<map_result_t<Mapper,T>>;
+		Records target(vlen, Uninitialized());
+		auto src = vec.get();
+		auto columns = target.data();
+		pool.parallel_for(0, vlen, cache_chunk_size(sizeof(T) + sizeof(map_result_t<Mapper,T>)),
+			[src, &columns, &mapper](size_t chunk_begin, size_t chunk_end)
+			{
+				for (size_t i = chunk_begin; i < chunk_end; ++i)
+					Records::set(columns, i, mapper(src[i]));
+			});
+		return target;
+	}
+
+	// every chunk is collected into its own container, the partial results
+	// are then combined in chunk order on the calling thread
+	template <class Mapper, class Collector>
+	auto collect_parallel(const Mapper& mapper, const Collector& collector,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		static_assert(Collector::combinable::value,
+			"collect_parallel() requires a collector which can combine partial results");
+		using B = map_result_t<Mapper,T>;
+		using Container = decltype(collector.template supply<B>());
+		const auto chunk_size = cache_chunk_size(sizeof(T) + sizeof(B));
+		std::vector<std::unique_ptr<Container>> partials((vlen + chunk_size - 1) / chunk_size);
+		auto src = vec.get();
+		pool.parallel_for(0, vlen, chunk_size,
+			[src, chunk_size, &mapper, &collector, &partials](size_t chunk_begin, size_t chunk_end)
+			{
+				auto partial = std::make_unique<Container>(collector.template supply<B>());
+				for (size_t i = chunk_begin; i < chunk_end; ++i)
+					collector.accumulate(*partial, mapper(src[i]));
+				partials[chunk_begin / chunk_size] = std::move(partial);
+			});
+		auto container = collector.template supply<B>();
+		for (auto& partial : partials)
+			collector.combine(container, std::move(*partial));
+		return collector.finish(std::move(container));
+	}
+
+	// the size is known up front, so element i goes straight to position i
+	template <class Mapper, class B>
+	size_t collect(const Mapper& mapper, const Collectors::Destination<B>& destination) const
+	{
+		if (destination.size < vlen)
+			throw std::out_of_range("destination is too small");
+		math::transform(mapper, vec.get(), destination.data, vlen);
+		return vlen;
+	}
+
+	template <class Mapper, class B>
+	size_t collect_parallel(const Mapper& mapper, const Collectors::Destination<B>& destination,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		if (destination.size < vlen)
+			throw std::out_of_range("destination is too small");
+		auto src = vec.get();
+		auto dst = destination.data;
+		pool.parallel_for(0, vlen, cache_chunk_size(sizeof(T) + sizeof(B)),
+			[src, dst, &mapper](size_t chunk_begin, size_t chunk_end)
+			{
+				math::transform(mapper, src + chunk_begin, dst + chunk_begin,
+					chunk_end - chunk_begin);
+			});
+		return vlen;
+	}
+
+	// the mapped elements which satisfy predicate, in order. small elements
+	// are mapped block by block into an L1 buffer and compacted from there
+	// into the result without branching on the predicate, so the cost hardly
+	// depends on how many elements are kept.
+	template <class Mapper, class Predicate>
+	Vector<map_result_t<Mapper,T>> filter(const Mapper& mapper, const Predicate& predicate) const
+	{
+		return filter(mapper, predicate, is_stageable<Mapper,T>());
+	}
+
+	// others are mapped one at a time, and only the selected ones are kept
+	template <class Mapper, class Predicate>
+	Vector<map_result_t<Mapper,T>> filter(const Mapper& mapper, const Predicate& predicate,
+		std::false_type) const
+	{
+		using B = map_result_t<Mapper,T>;
+		std::vector<B> selected;
+		auto src = vec.get();
+		for (size_t i = 0; i < vlen; ++i)
+		{
+			auto value = mapper(src[i]);
+			if (predicate(value))
+				selected.push_back(std::move(value));
+		}
+		return Collectors::ToVector<B>().finish(std::move(selected));
+	}
+
+	template <class Mapper, class Predicate>
+	Vector<map_result_t<Mapper,T>> filter(const Mapper& mapper, const Predicate& predicate,
+		std::true_type) const
+	{
+		using B = map_result_t<Mapper,T>;
+		Vector<B> selected(vlen, Uninitialized());
+		B* dst = selected.vec.get();
+		size_t count = 0;
+		map_blocks(mapper, vec.get(), vlen, [&predicate, dst, &count](const B* block, size_t m)
+		{
+			count += math::compress(predicate, block, dst + count, m);
+		});
+		// the buffer is kept if at least half of it is used
+		if (2 * count >= vlen)
+			return selected.slice(0, count);
+		Vector<B> target(count, Uninitialized());
+		std::move(selected.vec.get(), selected.vec.get() + count, target.vec.get());
+		return target;
+	}
+
+	// the first mapped element which satisfies predicate, if any. nothing
+	// after it is mapped.
+	template <class Mapper, class Predicate>
+	Slot<map_result_t<Mapper,T>> find_first(const Mapper& mapper, const Predicate& predicate) const
+	{
+		Slot<map_result_t<Mapper,T>> found;
+		auto src = vec.get();
+		for (size_t i = 0; i < vlen; ++i)
+		{
+			auto value = mapper(src[i]);
+			if (predicate(value))
+			{
+				found.emplace(std::move(value));
+				break;
+			}
+		}
+		return found;
+	}
+
+	template <class Mapper, class Predicate>
+	Slot<map_result_t<Mapper,T>> find_first_parallel(const Mapper& mapper, const Predicate& predicate,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		Slot<map_result_t<Mapper,T>> found;
+		auto first = find_parallel(mapper, predicate, false, pool);
+		if (first != vlen)
+			found.emplace(mapper(vec[first]));
+		return found;
+	}
+
+	template <class Mapper, class Predicate>
+	bool any_match(const Mapper& mapper, const Predicate& predicate) const
+	{
+		auto src = vec.get();
+		for (size_t i = 0; i < vlen; ++i)
+			if (predicate(mapper(src[i])))
+				return true;
+		return false;
+	}
+
+	template <class Mapper, class Predicate>
+	bool any_match_parallel(const Mapper& mapper, const Predicate& predicate,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		return find_parallel(mapper, predicate, true, pool) != vlen;
+	}
+
+	// the mapped elements up to, not including, the first one which does not
+	// satisfy predicate
+	template <class Mapper, class Predicate>
+	Vector<map_result_t<Mapper,T>> take_while(const Mapper& mapper, const Predicate& predicate) const
+	{
+		using B = map_result_t<Mapper,T>;
+		auto collector = Collectors::to_vector<B>();
+		auto container = collector.template supply<B>();
+		auto src = vec.get();
+		for (size_t i = 0; i < vlen; ++i)
+		{
+			auto value = mapper(src[i]);
+			if (!predicate(value))
+				break;
+			collector.accumulate(container, value);
+		}
+		return collector.finish(std::move(container));
+	}
+
+	// the first n mapped elements, only those are mapped
+	template <class Mapper>
+	Vector<map_result_t<Mapper,T>> limit(const Mapper& mapper, size_t n) const
+	{
+		Vector<map_result_t<Mapper,T>> target(std::min(n, vlen), Uninitialized());
+		math::transform(mapper, vec.get(), target.vec.get(), target.vlen);
+		return target;
+	}
+
+	// op-fold of the mapped elements into init, without materializing them
+	template <class Mapper, class Op, class R>
+	R reduce(const Mapper& mapper, const Op& op, R init) const
+	{
+		return shogun::reduce(mapper, vec.get(), vlen, op, init);
+	}
+
+	template <class Mapper>
+	map_result_t<Mapper,T> sum(const Mapper& mapper, Summation mode) const
+	{
+		return shogun::sum(mapper, vec.get(), vlen, mode);
+	}
+
+	template <class Mapper>
+	map_result_t<Mapper,T> sum_parallel(const Mapper& mapper, Summation mode,
+		ThreadPool& pool = ThreadPool::global()) const
+	{
+		return shogun::sum(mapper, vec.get(), vlen, mode, &pool);
+	}
+
+	template <class Mapper, class B>
+	B dot(const Mapper& mapper, const Vector<B>& other) const
+	{
+		if (other.vlen != vlen)
+			throw std::invalid_argument("dot() of vectors of different sizes");
+		return shogun::dot(mapper, vec.get(), other.vec.get(), vlen);
+	}
+
+	// join :: Monad m => m (m a) -> m a
+	// the sizes of the inner vectors are summed up first, so the flattened
+	// result is allocated exactly once
+	static Vector<T> join(const Vector<Vector<T>>& nested)
+	{
+		size_t size = 0;
+		for (size_t i = 0; i < nested.vlen; ++i)
+			size += nested.vec[i].vlen;
+		Vector<T> target(size, Uninitialized());
+		auto dst = target.vec.get();
+		for (size_t i = 0; i < nested.vlen; ++i)
+		{
+			const auto& inner = nested.vec[i];
+			dst = std::copy(inner.vec.get(), inner.vec.get() + inner.vlen, dst);
+		}
+		return target;
+	}
+
+	// (>>=) :: Monad m => m a -> (a -> m b) -> m b
+	template <class Mapper>
+	map_result_t<Mapper,T> bind(const Mapper& mapper) const
+	{
+		using B = typename map_result_t<Mapper,T>::value_type;
+		return Vector<B>::join(fmap(mapper));
+	}
+
+	friend std::ostream& operator<<(std::ostream& os, const Vector<T>& v)
 	{
 		os << "[";
 		std::for_each(v.begin(), v.end(), [&os](T val)
@@ -106,18 +464,65 @@ struct Vector : public Collection<T>
 		return os;
 	}
 
-	std::unique_ptr<T[]> vec;
+	SharedArray<T> vec;
 	size_t vlen;
+
+protected:
+	// over elements which are already there, e.g. a slice or a mapped file
+	Vector(SharedArray<T>&& _vec, size_t size) : vec(std::move(_vec)), vlen(size)
+	{
+	}
+
+private:
+	// index of the first match, or of any match if any is true, vlen if there
+	// is none. chunks are handed out in order, so chunks which start after a
+	// match are skipped, and those in flight stop at their next check.
+	template <class Mapper, class Predicate>
+	size_t find_parallel(const Mapper& mapper, const Predicate& predicate, bool any,
+		ThreadPool& pool) const
+	{
+		const size_t check_interval = 64;
+		const size_t none = vlen;
+		std::atomic<size_t> first(none);
+		auto cancelled = [&first, any, none](size_t i)
+		{
+			auto found = first.load(std::memory_order_relaxed);
+			return any ? found != none : found < i;
+		};
+		auto src = vec.get();
+		pool.parallel_for(0, vlen, cache_chunk_size(sizeof(T)),
+			[src, &mapper, &predicate, &first, &cancelled, check_interval](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+				{
+					if ((i - begin) % check_interval == 0 && cancelled(i))
+						return;
+					if (predicate(mapper(src[i])))
+					{
+						auto found = first.load();
+						while (i < found && !first.compare_exchange_weak(found, i));
+						return;
+					}
+				}
+			});
+		return first;
+	}
 };
 
 namespace Functional
 {
 
 template <class T>
-Eval<Vector,T,T> evaluate(const Vector<T>& f_a)
+Eval<Vector,T,T,Identity<T>> evaluate(const Vector<T>& f_a)
+{
+	return Eval<Vector,T,T,Identity<T>>(Identity<T>(), f_a);
+}
+
+// a temporary, e.g. a slice, is kept alive by the pipeline itself
+template <class T>
+Eval<Vector,T,T,Identity<T>> evaluate(Vector<T>&& f_a)
 {
-	auto identity_map = [](T&& a) { return std::forward<T>(a); };
-	return Eval<Vector,T,T>(identity_map, f_a);
+	return Eval<Vector,T,T,Identity<T>>(Identity<T>(), std::make_shared<const Vector<T>>(std::move(f_a)));
 }
 
 }
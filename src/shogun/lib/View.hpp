@@ -0,0 +1,149 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VIEW_HPP__
+#define VIEW_HPP__
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+namespace shogun
+{
+
+// Non-owning views into the storage of a Vector or Matrix. They are a
+// pointer plus a shape, so they are cheap to copy and pass through pipeline
+// stages, but only valid while the storage they point into is alive.
+// T is const qualified for views of const storage.
+
+// size elements which are stride elements apart, e.g. a row of a column
+// major matrix
+template <class T>
+struct VectorView
+{
+	struct iterator : std::iterator<std::random_access_iterator_tag,T>
+	{
+		iterator(T* _ptr, size_t _stride) : ptr(_ptr), stride(_stride) {}
+		iterator& operator++() { ptr += stride; return *this; }
+		iterator operator++(int) { auto ret = *this; ++(*this); return ret; }
+		iterator& operator--() { ptr -= stride; return *this; }
+		iterator operator--(int) { auto ret = *this; --(*this); return ret; }
+		iterator& operator+=(ptrdiff_t n) { ptr += n * static_cast<ptrdiff_t>(stride); return *this; }
+		iterator& operator-=(ptrdiff_t n) { return *this += -n; }
+		iterator operator+(ptrdiff_t n) const { auto ret = *this; return ret += n; }
+		iterator operator-(ptrdiff_t n) const { auto ret = *this; return ret -= n; }
+		friend iterator operator+(ptrdiff_t n, const iterator& it) { return it + n; }
+		ptrdiff_t operator-(const iterator& other) const { return (ptr - other.ptr) / static_cast<ptrdiff_t>(stride); }
+		bool operator==(const iterator& other) const { return ptr == other.ptr; }
+		bool operator!=(const iterator& other) const { return ptr != other.ptr; }
+		bool operator<(const iterator& other) const { return ptr < other.ptr; }
+		bool operator>(const iterator& other) const { return ptr > other.ptr; }
+		bool operator<=(const iterator& other) const { return ptr <= other.ptr; }
+		bool operator>=(const iterator& other) const { return ptr >= other.ptr; }
+		T& operator*() const { return *ptr; }
+		T* operator->() const { return ptr; }
+		T& operator[](ptrdiff_t n) const { return *(*this + n); }
+		T* ptr;
+		size_t stride;
+	};
+
+	VectorView(T* _data, size_t _size, size_t _stride = 1)
+	: data(_data), size(_size), stride(_stride)
+	{
+	}
+
+	T& operator[](size_t i) const
+	{
+		return data[i * stride];
+	}
+
+	iterator begin() const
+	{
+		return iterator(data, stride);
+	}
+
+	iterator end() const
+	{
+		return iterator(data + size * stride, stride);
+	}
+
+	T* data;
+	size_t size;
+	size_t stride;
+};
+
+// num_rows x num_cols block of a column major matrix whose columns are
+// leading_dimension elements apart
+template <class T>
+struct MatrixView
+{
+	MatrixView(T* _data, size_t _num_rows, size_t _num_cols, size_t _leading_dimension)
+	: data(_data), num_rows(_num_rows), num_cols(_num_cols), leading_dimension(_leading_dimension)
+	{
+	}
+
+	T& operator()(size_t i, size_t j) const
+	{
+		return data[i + j * leading_dimension];
+	}
+
+	VectorView<T> col(size_t j) const
+	{
+		return VectorView<T>(data + j * leading_dimension, num_rows);
+	}
+
+	VectorView<T> row(size_t i) const
+	{
+		return VectorView<T>(data + i, num_cols, leading_dimension);
+	}
+
+	// the rows x cols block at (i, j), clipped to the view
+	MatrixView block(size_t i, size_t j, size_t rows, size_t cols) const
+	{
+		return MatrixView(data + i + j * leading_dimension,
+			std::min(rows, num_rows - i), std::min(cols, num_cols - j), leading_dimension);
+	}
+
+	// the k-th size x size block on the diagonal
+	MatrixView diagonal_block(size_t k, size_t size) const
+	{
+		return block(k * size, k * size, size, size);
+	}
+
+	T* data;
+	size_t num_rows;
+	size_t num_cols;
+	size_t leading_dimension;
+};
+
+}
+#endif // VIEW_HPP__
@@ -0,0 +1,294 @@
+/**
+ * BSD 3-Clause License
+ *
+ * Copyright (c) 2017, Soumyajit De
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORK_STEALING_HPP__
+#define WORK_STEALING_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shogun
+{
+
+// A pool of workers which each own a deque of range tasks. A range task
+// larger than the grain splits off its upper half onto the owner's deque and
+// carries on with the lower half, so every thread works depth first on its
+// own, cache warm, part of the range, while idle threads steal the oldest and
+// hence largest pieces from the other end of someone else's deque. Unlike the
+// fixed chunking of ThreadPool this balances skewed and nested workloads,
+// e.g. a parallel_for called from within a parallel_for body pushes onto the
+// worker's own deque, and threads which wait for their range to finish keep
+// executing tasks instead of blocking.
+struct WorkStealingPool
+{
+	explicit WorkStealingPool(size_t num_workers) : queued(0), sleeping(0), stopping(false)
+	{
+		// the last queue is shared by the threads outside the pool
+		for (size_t i = 0; i < num_workers + 1; ++i)
+			queues.emplace_back(new Queue());
+		for (size_t i = 0; i < num_workers; ++i)
+			workers.emplace_back([this, i]() { work(i); });
+	}
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			stopping = true;
+		}
+		wakeup.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	static WorkStealingPool& global()
+	{
+		static WorkStealingPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+		return pool;
+	}
+
+	size_t num_threads() const
+	{
+		return workers.size() + 1;
+	}
+
+	// true if there is no queued work which idle threads could steal, i.e.
+	// when splitting off more work pays off
+	bool starving() const
+	{
+		return !workers.empty() && queued.load() == 0;
+	}
+
+	// runs body(range_begin, range_end) over [begin, end) split into ranges of
+	// at most grain elements and blocks until all of them are done. the first
+	// exception thrown by body is rethrown here, ranges which have not started
+	// by then are skipped.
+	template <class Body>
+	void parallel_for(size_t begin, size_t end, size_t grain, const Body& body)
+	{
+		if (begin >= end)
+			return;
+		grain = std::max<size_t>(grain, 1);
+		if (end - begin <= grain || workers.empty())
+		{
+			for (size_t range_begin = begin; range_begin < end; range_begin += grain)
+				body(range_begin, std::min(range_begin + grain, end));
+			return;
+		}
+
+		Job<Body> job(body, grain, end - begin);
+		const auto index = current_queue();
+		execute(Task{&Job<Body>::run, &job, begin, end}, index);
+		while (job.remaining.load() != 0)
+		{
+			Task task{};
+			if (find(index, task))
+				execute(task, index);
+			else
+				std::this_thread::yield();
+		}
+		if (job.error)
+			std::rethrow_exception(job.error);
+	}
+
+private:
+	struct Task;
+
+	struct JobBase
+	{
+		JobBase(size_t _grain, size_t size) : grain(_grain), remaining(size), failed(false)
+		{
+		}
+
+		size_t grain;
+		std::atomic<size_t> remaining;
+		std::atomic<bool> failed;
+		std::exception_ptr error;
+		std::mutex mutex;
+	};
+
+	template <class Body>
+	struct Job : JobBase
+	{
+		Job(const Body& _body, size_t grain, size_t size) : JobBase(grain, size), body(_body)
+		{
+		}
+
+		static void run(JobBase* job, size_t begin, size_t end)
+		{
+			static_cast<Job*>(job)->body(begin, end);
+		}
+
+		const Body& body;
+	};
+
+	struct Task
+	{
+		void (*run)(JobBase*, size_t, size_t);
+		JobBase* job;
+		size_t begin;
+		size_t end;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	// the queue the calling thread pushes to and pops from
+	size_t current_queue() const
+	{
+		return this_worker().pool == this ? this_worker().index : workers.size();
+	}
+
+	struct Worker
+	{
+		const WorkStealingPool* pool;
+		size_t index;
+	};
+
+	static Worker& this_worker()
+	{
+		static thread_local Worker worker{nullptr, 0};
+		return worker;
+	}
+
+	void push(size_t index, const Task& task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(queues[index]->mutex);
+			queues[index]->tasks.push_back(task);
+		}
+		queued.fetch_add(1);
+		if (sleeping.load() != 0)
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+			wakeup.notify_one();
+		}
+	}
+
+	// newest task of the own queue, or else the oldest one of another queue
+	bool find(size_t index, Task& task)
+	{
+		if (queued.load() == 0)
+			return false;
+		for (size_t i = 0; i < queues.size(); ++i)
+		{
+			auto& queue = *queues[(index + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+			if (i == 0)
+			{
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			else
+			{
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	void execute(Task task, size_t index)
+	{
+		auto job = task.job;
+		while (task.end - task.begin > job->grain)
+		{
+			auto middle = task.begin + (task.end - task.begin) / 2;
+			push(index, Task{task.run, job, middle, task.end});
+			task.end = middle;
+		}
+		if (!job->failed)
+		{
+			try
+			{
+				task.run(job, task.begin, task.end);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(job->mutex);
+				if (!job->failed.exchange(true))
+					job->error = std::current_exception();
+			}
+		}
+		// the job may be gone as soon as the last range is accounted for
+		job->remaining.fetch_sub(task.end - task.begin);
+	}
+
+	void work(size_t index)
+	{
+		this_worker() = Worker{this, index};
+		while (true)
+		{
+			Task task{};
+			if (find(index, task))
+			{
+				execute(task, index);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			sleeping.fetch_add(1);
+			wakeup.wait(lock, [this]() { return stopping || queued.load() != 0; });
+			sleeping.fetch_sub(1);
+			if (stopping)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> queued;
+	std::atomic<size_t> sleeping;
+	std::mutex sleep_mutex;
+	std::condition_variable wakeup;
+	bool stopping;
+};
+
+}
+#endif // WORK_STEALING_HPP__
@@ -35,7 +35,20 @@
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <array>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <shogun/lib/Vector.hpp>
+#include <shogun/lib/Stream.hpp>
+#include <shogun/lib/BlockReader.hpp>
+#include <shogun/lib/Mapped.hpp>
+#include <shogun/lib/Parse.hpp>
+#include <shogun/lib/Columnar.hpp>
+#include <shogun/lib/Pairwise.hpp>
+#include <shogun/lib/Records.hpp>
+#include <shogun/lib/Statistics.hpp>
 #include <benchmark/benchmark.h>
 
 using namespace shogun;
@@ -48,12 +61,6 @@ double sqrt(const int& a)
 Vector<double> test1(const Vector<int>& l)
 {
 	return Functional::evaluate(l)
-//		.bind([](int x)
-//		{
-//			Vector<int> v(x);
-//			std::iota(v.begin(), v.end(), 1);
-//			return v;
-//		})
 		.map(&sqrt)
 		.map([](double x)
 		{
@@ -80,6 +87,24 @@ Vector<double> test1(const Vector<int>& l)
 //		});
 }
 
+Vector<double> test1_erased(const Vector<int>& l)
+{
+	return Functional::evaluate(l)
+		.map(&sqrt)
+		.erased()
+		.map([](double x)
+		{
+			return std::log(x);
+		})
+		.erased()
+		.map([](double x)
+		{
+			return std::sin(x/2);
+		})
+		.erased()
+		.yield();
+}
+
 Vector<double> __attribute__ ((noinline)) test2(const Vector<int>& l)
 {
 	Vector<double> r(l.vlen);
@@ -92,11 +117,20 @@ Vector<double> __attribute__ ((noinline)) test2(const Vector<int>& l)
 
 size_t size = 1000;
 
+// heap allocations per iteration, counted at the resource every other
+// resource eventually allocates from
+static void count_allocations(benchmark::State& state, size_t before)
+{
+	state.counters["allocs"] = benchmark::Counter(
+		AlignedResource::instance().allocations() - before, benchmark::Counter::kAvgIterations);
+}
+
 static void functional(benchmark::State& state)
 {
 	Vector<int> l(size);
 	std::iota(l.begin(), l.end(), 1);
 	double c1 = 0;
+	auto allocations = AlignedResource::instance().allocations();
 	while (state.KeepRunning())
 	{
 		auto r = test1(l);
@@ -105,15 +139,76 @@ static void functional(benchmark::State& state)
 //		break;
 	}
 //	std::cout << c1 << std::endl;
+	count_allocations(state, allocations);
 }
 
 BENCHMARK(functional);
 
+static void functional_erased(benchmark::State& state)
+{
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	double c1 = 0;
+	while (state.KeepRunning())
+	{
+		auto r = test1_erased(l);
+		c1 = sqrt(std::accumulate(r.begin(), r.end(), 0.0));
+	}
+}
+
+BENCHMARK(functional_erased);
+
+static void functional_pool(benchmark::State& state)
+{
+	auto previous = set_default_resource(&PoolResource::local());
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	double c1 = 0;
+	auto allocations = AlignedResource::instance().allocations();
+	while (state.KeepRunning())
+	{
+		auto r = test1(l);
+		c1 = sqrt(std::accumulate(r.begin(), r.end(), 0.0));
+	}
+	count_allocations(state, allocations);
+	set_default_resource(previous);
+}
+
+BENCHMARK(functional_pool);
+
+static void functional_into(benchmark::State& state)
+{
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	auto pipeline = Functional::evaluate(l)
+		.map(&sqrt)
+		.map([](double x)
+		{
+			return std::log(x);
+		})
+		.map([](double x)
+		{
+			return std::sin(x/2);
+		});
+	Vector<double> r;
+	double c1 = 0;
+	auto allocations = AlignedResource::instance().allocations();
+	while (state.KeepRunning())
+	{
+		pipeline.yield_into(r);
+		c1 = sqrt(std::accumulate(r.begin(), r.end(), 0.0));
+	}
+	count_allocations(state, allocations);
+}
+
+BENCHMARK(functional_into);
+
 static void normal(benchmark::State& state)
 {
 	Vector<int> l(size);
 	std::iota(l.begin(), l.end(), 1);
 	double c2 = 0;
+	auto allocations = AlignedResource::instance().allocations();
 	while (state.KeepRunning())
 	{
 		auto r = test2(l);
@@ -122,8 +217,991 @@ static void normal(benchmark::State& state)
 //		break;
 	}
 //	std::cout << c2 << std::endl;
+	count_allocations(state, allocations);
 }
 
 BENCHMARK(normal);
 
+Vector<double> test3(const Vector<int>& l)
+{
+	return Functional::evaluate(l)
+		.map(math::Sqrt())
+		.map(math::Log())
+		.map(math::Div(2))
+		.map(math::Sin())
+		.yield();
+}
+
+static void vectorized(benchmark::State& state)
+{
+	auto level = math::simd_level();
+	math::simd_level() = static_cast<math::SIMD>(state.range(0));
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	double c3 = 0;
+	while (state.KeepRunning())
+	{
+		auto r = test3(l);
+		c3 = sqrt(std::accumulate(r.begin(), r.end(), 0.0));
+	}
+	math::simd_level() = level;
+}
+
+// none, sse4, avx2, avx512
+BENCHMARK(vectorized)->DenseRange(0, static_cast<int>(math::detect_simd()));
+
+// distance of a and b in units in the last place
+static double ulp_distance(double a, double b)
+{
+	if (a == b || (std::isnan(a) && std::isnan(b)))
+		return 0;
+	auto ordered = [](double x)
+	{
+		int64_t i;
+		std::memcpy(&i, &x, sizeof(i));
+		return i < 0 ? std::numeric_limits<int64_t>::min() - i : i;
+	};
+	return std::fabs(static_cast<double>(ordered(a) - ordered(b)));
+}
+
+template <class Op>
+static void kernel_accuracy(benchmark::State& state, const Op& op, const Vector<double>& x)
+{
+	auto level = math::simd_level();
+	math::simd_level() = static_cast<math::SIMD>(state.range(1));
+	Vector<double> y(x.vlen, Uninitialized());
+	while (state.KeepRunning())
+		math::transform(op, x.vec.get(), y.vec.get(), x.vlen);
+	math::simd_level() = level;
+	double max_ulp = 0;
+	for (size_t i = 0; i < x.vlen; ++i)
+		max_ulp = std::max(max_ulp, ulp_distance(y.vec[i], op(x.vec[i])));
+	state.counters["max_ulp"] = max_ulp;
+	if (max_ulp > 2)
+		state.SkipWithError("a batch kernel is more than 2 ulp off libm");
+	state.SetItemsProcessed(state.iterations() * x.vlen);
+}
+
+// the batch kernels of exp, log, sin and cos against libm, over inputs which
+// cover exp from underflow to overflow, log across the whole positive range
+// including denormals, and sin and cos up to 1e6
+static void kernel_accuracy(benchmark::State& state)
+{
+	std::mt19937_64 generator(5);
+	Vector<double> x(1 << 20, Uninitialized());
+	auto uniform = [&generator, &x](double low, double high)
+	{
+		std::uniform_real_distribution<double> distribution(low, high);
+		for (auto& v : x)
+			v = distribution(generator);
+	};
+	switch (state.range(0))
+	{
+	case 0:
+		uniform(-745.2, 709.78);
+		return kernel_accuracy(state, math::Exp(), x);
+	case 1:
+		uniform(std::log(4.9e-324), std::log(1.7e308));
+		for (auto& v : x)
+			v = std::exp(v);
+		return kernel_accuracy(state, math::Log(), x);
+	case 2:
+		uniform(-1e6, 1e6);
+		return kernel_accuracy(state, math::Sin(), x);
+	default:
+		uniform(-1e6, 1e6);
+		return kernel_accuracy(state, math::Cos(), x);
+	}
+}
+
+// exp, log, sin, cos for each instruction set up to the detected one
+BENCHMARK(kernel_accuracy)->Apply([](benchmark::internal::Benchmark* b)
+{
+	for (int op = 0; op < 4; ++op)
+		for (int level = 0; level <= static_cast<int>(math::detect_simd()); ++level)
+			b->Args({op, level});
+});
+
+static void functional_sum(benchmark::State& state)
+{
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	double c1 = 0;
+	auto allocations = AlignedResource::instance().allocations();
+	while (state.KeepRunning())
+	{
+		c1 = sqrt(Functional::evaluate(l)
+			.map(&sqrt)
+			.map([](double x)
+			{
+				return std::log(x);
+			})
+			.map([](double x)
+			{
+				return std::sin(x/2);
+			})
+			.sum());
+		benchmark::DoNotOptimize(c1);
+	}
+	count_allocations(state, allocations);
+}
+
+BENCHMARK(functional_sum);
+
+static void vectorized_sum(benchmark::State& state)
+{
+	Vector<int> l(size);
+	std::iota(l.begin(), l.end(), 1);
+	double c3 = 0;
+	while (state.KeepRunning())
+	{
+		c3 = sqrt(Functional::evaluate(l)
+			.map(math::Sqrt())
+			.map(math::Log())
+			.map(math::Div(2))
+			.map(math::Sin())
+			.sum());
+		benchmark::DoNotOptimize(c3);
+	}
+}
+
+BENCHMARK(vectorized_sum);
+
+size_t summation_size = 1 << 20;
+
+static Vector<double> summands()
+{
+	Vector<double> v(summation_size);
+	for (size_t i = 0; i < summation_size; ++i)
+		v.vec[i] = std::sin(i) * (i % 2 ? 1e-8 : 1e8);
+	return v;
+}
+
+static void summation_accumulate(benchmark::State& state)
+{
+	auto v = summands();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(std::accumulate(v.begin(), v.end(), 0.0));
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(summation_accumulate);
+
+// unordered, pairwise, compensated
+static void summation(benchmark::State& state)
+{
+	auto v = summands();
+	auto mode = static_cast<Summation>(state.range(0));
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).sum(mode));
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(summation)->DenseRange(0, 2);
+
+static void summation_parallel(benchmark::State& state)
+{
+	auto v = summands();
+	auto mode = static_cast<Summation>(state.range(0));
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).sum_parallel(mode));
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(summation_parallel)->DenseRange(0, 2)->UseRealTime();
+
+// mean and variance with two passes over the data
+static void moments_two_pass(benchmark::State& state)
+{
+	auto v = summands();
+	while (state.KeepRunning())
+	{
+		auto mean = std::accumulate(v.begin(), v.end(), 0.0) / summation_size;
+		auto m2 = std::accumulate(v.begin(), v.end(), 0.0, [mean](double acc, double x)
+		{
+			return acc + (x - mean) * (x - mean);
+		});
+		benchmark::DoNotOptimize(m2 / (summation_size - 1));
+	}
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(moments_two_pass);
+
+// the same in a single pass
+static void moments(benchmark::State& state)
+{
+	auto v = summands();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).collect(Collectors::moments()).variance());
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(moments);
+
+static void moments_parallel(benchmark::State& state)
+{
+	auto v = summands();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).collect_parallel(Collectors::moments()).variance());
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(moments_parallel)->UseRealTime();
+
+// a statistic of the caller's own, collected through its member functions
+struct Variance
+{
+	void add(double x)
+	{
+		moments.add(x);
+	}
+
+	void merge(const Variance& other)
+	{
+		moments.merge(other.moments);
+	}
+
+	double result() const
+	{
+		return moments.variance();
+	}
+
+	Moments<> moments;
+};
+
+static void moments_members(benchmark::State& state)
+{
+	auto v = summands();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).collect([]() { return Variance(); },
+			&Variance::add).result());
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(moments_members);
+
+static void moments_members_parallel(benchmark::State& state)
+{
+	auto v = summands();
+	auto collector = Collectors::of([]() { return Variance(); }, &Variance::add,
+		&Variance::merge, &Variance::result);
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(v).collect_parallel(collector));
+	state.SetBytesProcessed(state.iterations() * summation_size * sizeof(double));
+}
+
+BENCHMARK(moments_members_parallel)->UseRealTime();
+
+Vector<double> test4(const Vector<int>& l)
+{
+	return Functional::evaluate(l)
+		.bind([](int x)
+		{
+			Vector<int> v(x);
+			std::iota(v.begin(), v.end(), 1);
+			return v;
+		})
+		.map(&sqrt)
+		.map([](double x)
+		{
+			return std::log(x);
+		})
+		.map([](double x)
+		{
+			return std::sin(x/2);
+		})
+		.yield();
+}
+
+static void functional_bind(benchmark::State& state)
+{
+	Vector<int> l(100);
+	std::iota(l.begin(), l.end(), 1);
+	double c4 = 0;
+	auto allocations = AlignedResource::instance().allocations();
+	while (state.KeepRunning())
+	{
+		auto r = test4(l);
+		c4 = sqrt(std::accumulate(r.begin(), r.end(), 0.0));
+	}
+	count_allocations(state, allocations);
+}
+
+BENCHMARK(functional_bind);
+
+size_t large_size = 1 << 22;
+
+static void functional_large(benchmark::State& state)
+{
+	Vector<int> l(large_size);
+	std::iota(l.begin(), l.end(), 1);
+	while (state.KeepRunning())
+	{
+		auto r = test1(l);
+		benchmark::DoNotOptimize(r.vec.get());
+	}
+	state.SetItemsProcessed(state.iterations() * large_size);
+}
+
+BENCHMARK(functional_large)->Unit(benchmark::kMillisecond);
+
+static void functional_large_huge_pages(benchmark::State& state)
+{
+	HugePageResource huge_pages;
+	auto previous = set_default_resource(&huge_pages);
+	Vector<int> l(large_size);
+	std::iota(l.begin(), l.end(), 1);
+	while (state.KeepRunning())
+	{
+		auto r = test1(l);
+		benchmark::DoNotOptimize(r.vec.get());
+	}
+	state.SetItemsProcessed(state.iterations() * large_size);
+	set_default_resource(previous);
+}
+
+BENCHMARK(functional_large_huge_pages)->Unit(benchmark::kMillisecond);
+
+static void functional_parallel(benchmark::State& state)
+{
+	Vector<int> l(large_size);
+	std::iota(l.begin(), l.end(), 1);
+	while (state.KeepRunning())
+	{
+		auto r = Functional::evaluate(l)
+			.map(&sqrt)
+			.map([](double x)
+			{
+				return std::sin(std::log(x)/2);
+			})
+			.yield_parallel();
+		benchmark::DoNotOptimize(r.vec.get());
+	}
+	state.SetItemsProcessed(state.iterations() * large_size);
+}
+
+BENCHMARK(functional_parallel)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void pythagorean(benchmark::State& state)
+{
+	while (state.KeepRunning())
+	{
+		auto triples = Functional::range(1)
+			.map([](int z)
+			{
+				return Functional::range(1, z)
+					.map([z](int x)
+					{
+						return Functional::range(x, z)
+							.filter([x, z](int y)
+							{
+								return x*x + y*y == z*z;
+							})
+							.map([x, z](int y)
+							{
+								return std::make_tuple(x, y, z);
+							});
+					})
+					.flat_map();
+			})
+			.flat_map()
+			.take(state.range(0))
+			.yield();
+		benchmark::DoNotOptimize(triples.vec.get());
+	}
+}
+
+BENCHMARK(pythagorean)->Arg(10)->Arg(100);
+
+// triples with z < n, the inner streams grow with z
+static auto pythagorean_triples(int n)
+{
+	return Functional::range(1, n)
+		.map([](int z)
+		{
+			return Functional::range(1, z)
+				.map([z](int x)
+				{
+					return Functional::range(x, z)
+						.filter([x, z](int y)
+						{
+							return x*x + y*y == z*z;
+						})
+						.map([x, z](int y)
+						{
+							return std::make_tuple(x, y, z);
+						});
+				})
+				.flat_map();
+		})
+		.flat_map();
+}
+
+static void pythagorean_bounded(benchmark::State& state)
+{
+	while (state.KeepRunning())
+	{
+		auto triples = pythagorean_triples(state.range(0)).yield();
+		benchmark::DoNotOptimize(triples.vec.get());
+	}
+}
+
+BENCHMARK(pythagorean_bounded)->Arg(500)->Unit(benchmark::kMillisecond);
+
+static void pythagorean_parallel(benchmark::State& state)
+{
+	while (state.KeepRunning())
+	{
+		auto triples = pythagorean_triples(state.range(0)).collect_parallel(Collectors::to_vector());
+		benchmark::DoNotOptimize(triples.vec.get());
+	}
+}
+
+BENCHMARK(pythagorean_parallel)->Arg(500)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+using Point = std::tuple<double,double,double>;
+
+static Point point(const int& i)
+{
+	return std::make_tuple(std::sin(i), std::cos(i), i * 0.5);
+}
+
+static double third(const Point& p)
+{
+	return std::get<2>(p);
+}
+
+// a map over one field of tuple records, stored array of structs
+static void records_aos(benchmark::State& state)
+{
+	Vector<int> l(summation_size);
+	std::iota(l.begin(), l.end(), 0);
+	auto points = Functional::evaluate(l).map(point).yield();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(points).map(third).map(math::Sqrt()).sum());
+}
+
+BENCHMARK(records_aos);
+
+// the same with the tuples scattered into one column per field
+static void records_soa(benchmark::State& state)
+{
+	Vector<int> l(summation_size);
+	std::iota(l.begin(), l.end(), 0);
+	auto points = Functional::evaluate(l).map(point).yield_records();
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(points.field<2>().map(math::Sqrt()).sum());
+}
+
+BENCHMARK(records_soa);
+
+static Point scaled(const int& i)
+{
+	return std::make_tuple(i * 0.5, i * 2.0, i * 4.0);
+}
+
+// scattering tuple records into their columns, with records cheap enough
+// for the writes to dominate
+static void records_write(benchmark::State& state)
+{
+	Vector<int> l(summation_size);
+	std::iota(l.begin(), l.end(), 0);
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::evaluate(l).map(scaled).yield_records().vlen);
+	state.SetItemsProcessed(state.iterations() * l.vlen);
+}
+
+BENCHMARK(records_write)->Unit(benchmark::kMillisecond);
+
+// element i costs O(i), so the last chunks of a static partition take the
+// longest
+size_t skewed_size = 1 << 12;
+
+static double skewed_work(size_t i)
+{
+	double result = 0;
+	for (size_t j = 0; j < i; ++j)
+		result += std::sin(j);
+	return result;
+}
+
+static void skewed_static(benchmark::State& state)
+{
+	auto& pool = ThreadPool::global();
+	std::vector<double> results(skewed_size);
+	while (state.KeepRunning())
+	{
+		pool.parallel_for(0, skewed_size, skewed_size / pool.num_threads(),
+			[&results](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					results[i] = skewed_work(i);
+			});
+		benchmark::DoNotOptimize(results.data());
+	}
+}
+
+BENCHMARK(skewed_static)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void skewed_stealing(benchmark::State& state)
+{
+	auto& pool = WorkStealingPool::global();
+	std::vector<double> results(skewed_size);
+	while (state.KeepRunning())
+	{
+		pool.parallel_for(0, skewed_size, 1,
+			[&results](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; ++i)
+					results[i] = skewed_work(i);
+			});
+		benchmark::DoNotOptimize(results.data());
+	}
+}
+
+BENCHMARK(skewed_stealing)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+using Sample = std::array<double,16>;
+
+size_t num_samples = 1 << 11;
+
+static Vector<Sample> samples()
+{
+	Vector<Sample> v(num_samples);
+	for (size_t i = 0; i < num_samples; ++i)
+		for (size_t d = 0; d < v.vec[i].size(); ++d)
+			v.vec[i][d] = std::sin(i * v.vec[i].size() + d);
+	return v;
+}
+
+struct GaussianKernel
+{
+	double operator()(const Sample& x, const Sample& y) const
+	{
+		double distance = 0;
+		for (size_t d = 0; d < x.size(); ++d)
+			distance += (x[d] - y[d]) * (x[d] - y[d]);
+		return std::exp(-distance);
+	}
+};
+
+// one parallel launch per column, as in CKernel::get_kernel_matrix
+static void kernel_matrix_columns(benchmark::State& state)
+{
+	auto x = samples();
+	Matrix<double> result(num_samples, num_samples);
+	while (state.KeepRunning())
+	{
+		for (size_t j = 0; j < num_samples; ++j)
+		{
+			const auto& sample = x.vec[j];
+			auto column = result.matrix.get() + j * num_samples;
+			ThreadPool::global().parallel_for(0, num_samples, cache_chunk_size(sizeof(Sample)),
+				[&x, &sample, column](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++i)
+						column[i] = GaussianKernel()(x.vec[i], sample);
+				});
+		}
+		benchmark::DoNotOptimize(result.matrix.get());
+	}
+}
+
+BENCHMARK(kernel_matrix_columns)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void kernel_matrix_tiled(benchmark::State& state)
+{
+	auto x = samples();
+	Matrix<double> result(num_samples, num_samples);
+	while (state.KeepRunning())
+	{
+		Functional::pairwise_into(x, x, GaussianKernel(), result);
+		benchmark::DoNotOptimize(result.matrix.get());
+	}
+}
+
+BENCHMARK(kernel_matrix_tiled)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void kernel_matrix_symmetric(benchmark::State& state)
+{
+	auto x = samples();
+	Matrix<double> result(num_samples, num_samples);
+	while (state.KeepRunning())
+	{
+		Functional::pairwise_symmetric_into(x, GaussianKernel(), result);
+		benchmark::DoNotOptimize(result.matrix.get());
+	}
+}
+
+BENCHMARK(kernel_matrix_symmetric)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// a statistic per diagonal block of a kernel matrix, read through views
+static void diagonal_blocks(benchmark::State& state)
+{
+	auto x = samples();
+	auto kernel_matrix = Functional::pairwise_symmetric(x, GaussianKernel());
+	auto allocations = AlignedResource::instance().allocations();
+	while (state.KeepRunning())
+	{
+		auto statistic = kernel_matrix.diagonal_block_stream(state.range(0))
+			.map([](const MatrixView<const double>& block)
+			{
+				double sum = 0;
+				for (size_t j = 0; j < block.num_cols; ++j)
+					for (auto value : block.col(j))
+						sum += value;
+				return sum / (block.num_rows * block.num_cols);
+			})
+			.mean();
+		benchmark::DoNotOptimize(statistic);
+	}
+	count_allocations(state, allocations);
+}
+
+BENCHMARK(diagonal_blocks)->Arg(64)->Arg(256);
+
+// sample norms which four consumers read, recomputed every time or cached
+static void cache_reuse(benchmark::State& state)
+{
+	auto x = samples();
+	auto norm = [](const Sample& sample)
+	{
+		double squared = 0;
+		for (auto value : sample)
+			squared += value * value;
+		return std::sqrt(squared);
+	};
+	while (state.KeepRunning())
+	{
+		auto norms = Functional::evaluate(x).map(norm);
+		auto cached = norms.cache();
+		double total = 0;
+		for (size_t consumer = 0; consumer < 4; ++consumer)
+			total += state.range(0) ? cached.evaluate().sum() : norms.sum();
+		benchmark::DoNotOptimize(total);
+	}
+}
+
+BENCHMARK(cache_reuse)->Arg(0)->Arg(1);
+
+// a match near the front: 0 materializes everything before looking, 1 stops
+// at the match, 2 stops every chunk of the pool
+static void short_circuit(benchmark::State& state)
+{
+	Vector<double> v(summation_size);
+	std::iota(v.begin(), v.end(), 0);
+	auto is_match = [](const double& x) { return x > 32; };
+	auto e = Functional::evaluate(v).map(math::Sqrt());
+	while (state.KeepRunning())
+	{
+		switch (state.range(0))
+		{
+		case 0:
+		{
+			auto roots = e.yield();
+			benchmark::DoNotOptimize(std::any_of(roots.vec.get(), roots.vec.get() + roots.vlen, is_match));
+			break;
+		}
+		case 1:
+			benchmark::DoNotOptimize(e.any_match(is_match));
+			break;
+		default:
+			benchmark::DoNotOptimize(e.any_match_parallel(is_match));
+		}
+	}
+}
+
+BENCHMARK(short_circuit)->Arg(0)->Arg(1)->Arg(2);
+
+
+// uniform in [0, 1), so keeping the elements below p% of it keeps about p% of
+// them in random order
+static Vector<double> uniform_samples()
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<double> uniform;
+	Vector<double> v(summation_size, Uninitialized());
+	std::generate(v.begin(), v.end(), [&]() { return uniform(generator); });
+	return v;
+}
+
+static void filter_branching(benchmark::State& state)
+{
+	auto v = uniform_samples();
+	double threshold = state.range(0) / 100.0;
+	while (state.KeepRunning())
+	{
+		std::vector<double> selected;
+		for (size_t i = 0; i < v.vlen; ++i)
+			if (v.vec[i] < threshold)
+				selected.push_back(v.vec[i]);
+		benchmark::DoNotOptimize(selected.data());
+	}
+}
+
+BENCHMARK(filter_branching)->Arg(1)->Arg(10)->Arg(25)->Arg(50)->Arg(75)->Arg(90)->Arg(99);
+
+static void filter_selection(benchmark::State& state)
+{
+	auto v = uniform_samples();
+	double threshold = state.range(0) / 100.0;
+	auto e = Functional::evaluate(v);
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(e.filter([threshold](const double& x) { return x < threshold; }).yield());
+}
+
+BENCHMARK(filter_selection)->Arg(1)->Arg(10)->Arg(25)->Arg(50)->Arg(75)->Arg(90)->Arg(99);
+
+static void filter_compress(benchmark::State& state)
+{
+	auto v = uniform_samples();
+	double threshold = state.range(0) / 100.0;
+	auto e = Functional::evaluate(v);
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(e.filter(math::Less(threshold)).yield());
+}
+
+BENCHMARK(filter_compress)->Arg(1)->Arg(10)->Arg(25)->Arg(50)->Arg(75)->Arg(90)->Arg(99);
+
+// elements too large to buffer are selected one at a time
+static void filter_strings(benchmark::State& state)
+{
+	Vector<int> v(10000, Uninitialized());
+	std::iota(v.begin(), v.end(), 0);
+	auto e = Functional::evaluate(v).map([](int i) { return "sample " + std::to_string(i); });
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(e.filter([](const std::string& s) { return s.back() == '7'; }).yield());
+}
+
+BENCHMARK(filter_strings);
+
+// producing a block and reducing it cost about the same, so with a second
+// core async() can hide one behind the other. the counters show how full the
+// queue between them ran.
+static Vector<double> produce_block(int b)
+{
+	Vector<double> block(4096, Uninitialized());
+	for (size_t i = 0; i < block.vlen; ++i)
+		block.vec[i] = std::sin(b + i * 1e-3);
+	return block;
+}
+
+static double reduce_block(const Vector<double>& block)
+{
+	return Functional::evaluate(block).map([](double x) { return std::cos(x); }).sum();
+}
+
+static void async_pipeline(benchmark::State& state)
+{
+	QueueStats stats{};
+	while (state.KeepRunning())
+	{
+		auto blocks = Functional::range(0, 256).map(&produce_block);
+		if (state.range(0) == 0)
+			benchmark::DoNotOptimize(blocks.map(&reduce_block).reduce(std::plus<double>(), 0.0));
+		else
+		{
+			auto pipelined = blocks.async(state.range(0)).map(&reduce_block);
+			benchmark::DoNotOptimize(pipelined.reduce(std::plus<double>(), 0.0));
+			stats = pipelined.source.source.stats();
+		}
+	}
+	state.counters["full"] = stats.full;
+	state.counters["mean_occupancy"] = stats.mean_occupancy();
+}
+
+BENCHMARK(async_pipeline)->Arg(0)->Arg(2)->Arg(16)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// 0 pulls one element at a time through the pipeline by hand, 1 through
+// sum(), which does the same since the filter does not batch
+static void range_batches(benchmark::State& state)
+{
+	while (state.KeepRunning())
+	{
+		auto odd_squares = Functional::range<long>(0, summation_size)
+			.map([](long x) { return x * x; })
+			.filter([](const long& x) { return x & 1; });
+		long total = 0;
+		if (state.range(0) == 0)
+			while (odd_squares.pull([&total](const long& x) { total += x; }));
+		else
+			total = odd_squares.sum();
+		benchmark::DoNotOptimize(total);
+	}
+}
+
+BENCHMARK(range_batches)->Arg(0)->Arg(1);
+
+static void strided_range(benchmark::State& state)
+{
+	while (state.KeepRunning())
+		benchmark::DoNotOptimize(Functional::range<double>(0, 1, 1.0 / summation_size)
+			.map([](double x) { return x * x; }).sum());
+}
+
+BENCHMARK(strided_range);
+
+// one large vector fanned out into a pipeline per part of it: 0 gives every
+// pipeline a deep copy, 1 a shared slice
+static void fan_out(benchmark::State& state)
+{
+	const size_t parts = 16;
+	Vector<double> v(summation_size, Uninitialized());
+	std::iota(v.begin(), v.end(), 0);
+	const auto part_size = v.vlen / parts;
+	while (state.KeepRunning())
+	{
+		double total = 0;
+		for (size_t k = 0; k < parts; ++k)
+		{
+			auto part = state.range(0) == 0
+				? Functional::evaluate(v).yield().slice(k * part_size, (k + 1) * part_size)
+				: v.slice(k * part_size, (k + 1) * part_size);
+			total += Functional::evaluate(std::move(part)).map(math::Sqrt()).sum();
+		}
+		benchmark::DoNotOptimize(total);
+	}
+}
+
+BENCHMARK(fan_out)->Arg(0)->Arg(1);
+
+// opening a feature file of n doubles and reading its first element: 0 reads
+// the whole file into a vector, 1 maps it
+static void open_features(benchmark::State& state)
+{
+	const auto n = static_cast<size_t>(state.range(1));
+	const std::string path = "/tmp/fstream_features.bin";
+	Vector<double> features(n, Uninitialized());
+	std::iota(features.begin(), features.end(), 0);
+	Functional::save_raw(features, path);
+	while (state.KeepRunning())
+	{
+		if (state.range(0) == 0)
+		{
+			std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+			Vector<double> loaded(n, Uninitialized());
+			benchmark::DoNotOptimize(std::fread(loaded.vec.get(), sizeof(double), n, file.get()));
+			benchmark::DoNotOptimize(loaded.vec[0]);
+		}
+		else
+		{
+			MappedVector<double> mapped(path);
+			benchmark::DoNotOptimize(static_cast<const Vector<double>&>(mapped).vec[0]);
+		}
+	}
+	std::remove(path.c_str());
+}
+
+BENCHMARK(open_features)->Args({0, 1 << 16})->Args({0, 1 << 22})->Args({1, 1 << 16})->Args({1, 1 << 22});
+
+static double block_work(const VectorView<const double>& block)
+{
+	double total = 0;
+	for (size_t i = 0; i < block.size; ++i)
+		total += std::sin(block[i]);
+	return total;
+}
+
+// a file processed block by block: 0 reads it whole first, 1 reads blocks on
+// a background thread while the earlier ones are processed
+static void out_of_core_blocks(benchmark::State& state)
+{
+	const std::string path = "/tmp/fstream_blocks.bin";
+	const size_t block_size = 1 << 14;
+	Vector<double> data(summation_size, Uninitialized());
+	std::iota(data.begin(), data.end(), 0);
+	Functional::save_raw(data, path);
+	while (state.KeepRunning())
+	{
+		if (state.range(0) == 0)
+		{
+			std::unique_ptr<FILE, int(*)(FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+			Vector<double> loaded(summation_size, Uninitialized());
+			benchmark::DoNotOptimize(std::fread(loaded.vec.get(), sizeof(double), loaded.vlen, file.get()));
+			benchmark::DoNotOptimize(Functional::block_stream(loaded, block_size)
+				.map(&block_work).reduce(std::plus<double>(), 0.0));
+		}
+		else
+			benchmark::DoNotOptimize(Functional::read_blocks<double>(path, block_size, 2)
+				.map(&block_work).reduce(std::plus<double>(), 0.0));
+	}
+	std::remove(path.c_str());
+}
+
+BENCHMARK(out_of_core_blocks)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// parsing a csv table of 4 columns of doubles: 0 with strtod(), 1 as a
+// stream of numbers, 2 into a matrix
+static void parse_csv(benchmark::State& state)
+{
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<double> distribution(-1e3, 1e3);
+	std::string csv;
+	char field[32];
+	for (size_t i = 0; i < (1 << 20); ++i)
+	{
+		csv.append(field, std::snprintf(field, sizeof(field), "%.9g", distribution(generator)));
+		csv += i % 4 == 3 ? '\n' : ',';
+	}
+	Vector<char> text(csv.size(), Uninitialized());
+	std::copy(csv.begin(), csv.end(), text.vec.get());
+	while (state.KeepRunning())
+	{
+		if (state.range(0) == 0)
+		{
+			double total = 0;
+			char* p = &csv[0];
+			for (char* end = p + csv.size(); p < end; ++p)
+				total += std::strtod(p, &p);
+			benchmark::DoNotOptimize(total);
+		}
+		else if (state.range(0) == 1)
+			benchmark::DoNotOptimize(Functional::parse_numbers<double>(text).reduce(std::plus<double>(), 0.0));
+		else
+			benchmark::DoNotOptimize(Functional::parse_table<double>(text).num_rows);
+	}
+	state.SetBytesProcessed(state.iterations() * csv.size());
+}
+
+BENCHMARK(parse_csv)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+// summing a column of increasing timestamps stored on disk: 0 as a raw file,
+// 1 as a column file, which delta encodes them
+static void column_scan(benchmark::State& state)
+{
+	const std::string path = state.range(0) == 0 ? "/tmp/fstream_raw.bin" : "/tmp/fstream_column.bin";
+	std::mt19937_64 generator(11);
+	Vector<int64_t> timestamps(1 << 22, Uninitialized());
+	int64_t time = 1500000000000;
+	for (auto& t : timestamps)
+		t = time += generator() % 1000;
+	if (state.range(0) == 0)
+		Functional::save_raw(timestamps, path);
+	else
+		Functional::save_column(timestamps, path);
+	size_t file_size = 0;
+	while (state.KeepRunning())
+	{
+		if (state.range(0) == 0)
+		{
+			MappedVector<int64_t> raw(path);
+			const Vector<int64_t>& values = raw;
+			benchmark::DoNotOptimize(std::accumulate(values.vec.get(), values.vec.get() + values.vlen, int64_t(0)));
+			file_size = values.vlen * sizeof(int64_t);
+		}
+		else
+		{
+			ColumnFile<int64_t> column(path);
+			benchmark::DoNotOptimize(Functional::read_column(column).reduce(std::plus<int64_t>(), int64_t(0)));
+			file_size = column.file_size();
+		}
+	}
+	state.counters["file_bytes"] = file_size;
+	state.SetItemsProcessed(state.iterations() * timestamps.vlen);
+	std::remove(path.c_str());
+}
+
+BENCHMARK(column_scan)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();